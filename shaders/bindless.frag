@@ -0,0 +1,35 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+// For the runtime sized array.
+#extension GL_EXT_nonuniform_qualifier : require
+
+// shader.frag with the texture read from the bindless table, see
+// imBindlessTextures, in place of a binding of its own.
+layout(constant_id = 0) const bool TEXTURED = true;
+layout(constant_id = 1) const bool VERTEX_COLOR = false;
+layout(constant_id = 2) const float TINT_STRENGTH = 1.0;
+
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+layout(push_constant) uniform Material {
+	uint textureIndex;
+} material;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 texCoord;
+layout(location = 2) in vec4 tint;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	vec4 color = vec4(1.0);
+	if (TEXTURED) {
+		// Uniform across the draw, so no nonuniformEXT is needed.
+		color *= texture(textures[material.textureIndex], texCoord);
+	}
+	if (VERTEX_COLOR) {
+		color.rgb *= fragColor;
+	}
+
+	outColor = color * mix(vec4(1.0), tint, TINT_STRENGTH);
+}
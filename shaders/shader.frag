@@ -1,13 +1,28 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// Baked in per pipeline with VkSpecializationInfo, see imSpecConstant.
+layout(constant_id = 0) const bool TEXTURED = true;
+layout(constant_id = 1) const bool VERTEX_COLOR = false;
+layout(constant_id = 2) const float TINT_STRENGTH = 1.0;
+
 layout(binding = 1) uniform sampler2D tex;
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 texCoord;
+layout(location = 2) in vec4 tint;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-	outColor = texture(tex, texCoord);
+	// Constant conditions, so the unused paths are compiled out.
+	vec4 color = vec4(1.0);
+	if (TEXTURED) {
+		color *= texture(tex, texCoord);
+	}
+	if (VERTEX_COLOR) {
+		color.rgb *= fragColor;
+	}
+
+	outColor = color * mix(vec4(1.0), tint, TINT_STRENGTH);
 }
@@ -5,8 +5,13 @@ layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
+// Per instance, a mat4 occupies locations 3 through 6.
+layout(location = 3) in mat4 inTransform;
+layout(location = 7) in vec4 inParams;
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec4 fragTint;
 
 layout(binding = 0) uniform UniformBufferObject {
 	mat4 model;
@@ -19,8 +24,9 @@ out gl_PerVertex {
 };
 
 void main() {
-	mat4 mvp = ubo.proj * ubo.view * ubo.model;
+	mat4 mvp = ubo.proj * ubo.view * ubo.model * inTransform;
 	gl_Position = mvp * vec4(inPosition, 1.0);
 	fragColor = inColor;
 	fragTexCoord = inTexCoord;
+	fragTint = inParams;
 }
@@ -20,12 +20,16 @@
 #include <string>
 #include <limits>
 #include <vector>
+#include <array>
 #include <set>
 
 #ifdef NDEBUG
 	const bool VALIDATION_LAYERS_ENABLED = false;
+	const bool SHADER_HOT_RELOAD_ENABLED = false;
 #else
 	const bool VALIDATION_LAYERS_ENABLED = true;
+	/// Recompile and reload shaders when their GLSL source changes.
+	const bool SHADER_HOT_RELOAD_ENABLED = true;
 #endif
 
 const std::vector<const char *> VALIDATION_LAYERS = {
@@ -36,4 +40,7 @@ const std::vector<const char *> DEVICE_EXTENSIONS = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+/// Number of frames the CPU may record ahead of the GPU.
+const size_t MAX_FRAMES_IN_FLIGHT = 2;
+
 #endif
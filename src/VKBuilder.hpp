@@ -10,6 +10,7 @@
 #include "imImage.h"
 #include "imPipeline.h"
 #include "imSwapChain.h"
+#include "imLayoutCache.h"
 
 class VKBuilder {
 public:
@@ -25,7 +26,19 @@ public:
 		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.pEngineName = "No Engine";
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_0;
+		// 1.1 for vkGetPhysicalDeviceFeatures2, and descriptor indexing
+		// relies on VK_KHR_maintenance3, which is core in 1.1. A 1.0 loader
+		// rejects instances asking for it, and lacks the function to ask,
+		// so those get 1.0 and no bindless textures.
+		instanceVersion = VK_API_VERSION_1_0;
+		auto enumerateVersion = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(
+			nullptr, "vkEnumerateInstanceVersion");
+		uint32_t loaderVersion;
+		if (enumerateVersion != nullptr && enumerateVersion(&loaderVersion) == VK_SUCCESS
+				&& loaderVersion >= VK_API_VERSION_1_1) {
+			instanceVersion = VK_API_VERSION_1_1;
+		}
+		appInfo.apiVersion = instanceVersion;
 
 		VkInstanceCreateInfo createInfo = { };
 		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -152,16 +165,71 @@ public:
 		return requiredExtensions.empty();
 	}
 
-	static void CreateLogicalDevice(VkQueue &gQueue, VkQueue &pQueue) {
+	/// True if the device can hold a partially bound sampler array, of
+	/// RUNTIME_ARRAY_SIZE elements, that may be updated after it is bound.
+	static bool CheckDescriptorIndexingSupport(VkPhysicalDevice pDevice) {
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(pDevice, &properties);
+		if (instanceVersion < VK_API_VERSION_1_1 ||
+				properties.apiVersion < VK_API_VERSION_1_1) {
+			return false;
+		}
+
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(pDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(pDevice, nullptr, 
+			&extensionCount, extensions.data());
+
+		bool found = false;
+		for (const auto &extension : extensions) {
+			if (strcmp(extension.extensionName, 
+					VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0) {
+				found = true;
+			}
+		}
+
+		if (!found) {
+			return false;
+		}
+
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing = { };
+		indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		VkPhysicalDeviceFeatures2 features = { };
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &indexing;
+		vkGetPhysicalDeviceFeatures2(pDevice, &features);
+
+		VkPhysicalDeviceDescriptorIndexingPropertiesEXT limits = { };
+		limits.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+		VkPhysicalDeviceProperties2 properties2 = { };
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &limits;
+		vkGetPhysicalDeviceProperties2(pDevice, &properties2);
+
+		// The shader indexes its sampler array with a push constant.
+		return features.features.shaderSampledImageArrayDynamicIndexing &&
+			indexing.runtimeDescriptorArray &&
+			indexing.descriptorBindingPartiallyBound &&
+			indexing.descriptorBindingSampledImageUpdateAfterBind &&
+			indexing.descriptorBindingUpdateUnusedWhilePending &&
+			limits.maxPerStageDescriptorUpdateAfterBindSampledImages >= RUNTIME_ARRAY_SIZE &&
+			limits.maxDescriptorSetUpdateAfterBindSampledImages >= RUNTIME_ARRAY_SIZE &&
+			limits.maxPerStageDescriptorUpdateAfterBindSamplers >= RUNTIME_ARRAY_SIZE &&
+			limits.maxDescriptorSetUpdateAfterBindSamplers >= RUNTIME_ARRAY_SIZE &&
+			limits.maxPerStageUpdateAfterBindResources >= RUNTIME_ARRAY_SIZE;
+	}
+
+	static void CreateLogicalDevice(VkQueue &gQueue, VkQueue &pQueue, VkQueue &tQueue) {
 		QueueFamilyIndices indices = FindQueueFamilies(physicalDevice, surface);
 		float queuePriority = 1.0f;
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 		std::set<int> uniqueQueueFamilies = { 
-			indices.graphicsFamily, indices.presentFamily 
+			indices.graphicsFamily, indices.presentFamily, indices.transferFamily
 		};
 
-		// Need to create a graphics and a presentation queue.
+		// Need to create a graphics, a presentation and a transfer queue.
 		for (int queueFamily : uniqueQueueFamilies) {
 			VkDeviceQueueCreateInfo queueCreateInfo = { };
 			queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
@@ -172,16 +240,40 @@ public:
 		}
 
 		// Any additional features we need (e.g. Geometry Shaders).
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
 		VkPhysicalDeviceFeatures deviceFeatures = { };
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		// Optional, lets the culling pass issue every draw group in one call.
+		deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+		deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+		// Optional, block compressed textures are rejected when missing.
+		deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
 
 		VkDeviceCreateInfo createInfo = { };
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pEnabledFeatures = &deviceFeatures;
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(DEVICE_EXTENSIONS.size());
-		createInfo.ppEnabledExtensionNames = DEVICE_EXTENSIONS.data();
+
+		// Optional, bindless textures are only used if the device has them.
+		std::vector<const char *> extensions = DEVICE_EXTENSIONS;
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = { };
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+		descriptorIndexingSupported = CheckDescriptorIndexingSupport(physicalDevice);
+		if (descriptorIndexingSupported) {
+			deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+			indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+			indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+			indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+			extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+			createInfo.pNext = &indexingFeatures;
+		}
+
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		createInfo.ppEnabledExtensionNames = extensions.data();
 
 		if (VALIDATION_LAYERS_ENABLED) {
 			createInfo.enabledLayerCount = static_cast<uint32_t>(VALIDATION_LAYERS.size());
@@ -196,6 +288,13 @@ public:
 
 		vkGetDeviceQueue(device, indices.graphicsFamily, 0, &gQueue);
 		vkGetDeviceQueue(device, indices.presentFamily, 0, &pQueue);
+		vkGetDeviceQueue(device, indices.transferFamily, 0, &tQueue);
+
+		if (indices.transferFamily != indices.graphicsFamily) {
+			std::cout << "Using dedicated transfer queue family " 
+				<< indices.transferFamily << " for uploads." << std::endl;
+			std::cout << "-----------------------------------------------" << std::endl;
+		}
 	}
 
 	static bool CheckValidationLayerSupport() {
@@ -244,119 +343,14 @@ public:
 		// Command pool can only submit to one queue, we'll be submitting
 		// graphics calls.
 		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
-		poolInfo.flags = 0; // Optional
+		// Frame command buffers are re-recorded every frame.
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 		if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create command pool!");
 		}
 	}
 
-	static void CreateDescriptorSetLayout(VkDescriptorSetLayout &layout) {
-		VkDescriptorSetLayoutBinding uboLayoutBinding = { };
-		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		uboLayoutBinding.descriptorCount = 1;
-		uboLayoutBinding.binding = 0;
-		uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
-
-		VkDescriptorSetLayoutBinding samplerLayoutBinding = { };
-		samplerLayoutBinding.binding = 1;
-		samplerLayoutBinding.descriptorCount = 1;
-		samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		samplerLayoutBinding.pImmutableSamplers = nullptr;
-		samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-		std::array<VkDescriptorSetLayoutBinding, 2> bindings = {
-			uboLayoutBinding, samplerLayoutBinding
-		};
-
-		VkDescriptorSetLayoutCreateInfo layoutInfo = { };
-		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-		layoutInfo.pBindings = bindings.data();
-
-		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) 
-				!= VK_SUCCESS) {
-			throw std::runtime_error("Failed to create descriptor set layout!");
-		}
-	}
-
-	static void CreateUniformBuffer(VkBuffer &uniformBuffer, 
-			VkDeviceMemory &uniformBufferMemory) {
-		VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-		CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			uniformBuffer, uniformBufferMemory);
-	}
-
-	static void CreateDescriptorPool(VkDescriptorPool &pool) {
-		std::array<VkDescriptorPoolSize, 2> poolSizes = { };
-		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSizes[0].descriptorCount = 1;
-		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		poolSizes[1].descriptorCount = 1;
-		
-		VkDescriptorPoolCreateInfo poolInfo = { };
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-		poolInfo.pPoolSizes = poolSizes.data();
-		poolInfo.maxSets = 1;
-
-		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) 
-				!= VK_SUCCESS) {
-			throw std::runtime_error("Failed to create descriptor pool!");
-		}
-
-	}
-
-	static void CreateDescriptorSet(VkDescriptorPool &pool, VkDescriptorSet &descSet, 
-			VkBuffer &buffer, VkDescriptorSetLayout &layout, imImage &image) {
-		VkDescriptorSetLayout layouts[] = { layout };
-
-		VkDescriptorSetAllocateInfo allocInfo = { };
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = pool;
-		allocInfo.descriptorSetCount = 1;
-		allocInfo.pSetLayouts = layouts;
-
-		if (vkAllocateDescriptorSets(device, &allocInfo, &descSet) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to allocate descriptor set!");
-		}
-
-		VkDescriptorBufferInfo bufferInfo = { };
-		bufferInfo.buffer = buffer;
-		bufferInfo.offset = 0;
-		bufferInfo.range = sizeof(buffer);
-
-		VkDescriptorImageInfo imageInfo = { };
-		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfo.imageView = image.view;
-		imageInfo.sampler = image.sampler;
-
-		std::array<VkWriteDescriptorSet, 2> descriptorWrites = { };
-
-		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[0].dstSet = descSet;
-		descriptorWrites[0].dstBinding = 0;
-		descriptorWrites[0].dstArrayElement = 0;
-
-		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrites[0].descriptorCount = 1;
-		descriptorWrites[0].pBufferInfo = &bufferInfo;
-
-		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[1].dstSet = descSet;
-		descriptorWrites[1].dstBinding = 1;
-		descriptorWrites[1].dstArrayElement = 0;
-
-		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		descriptorWrites[1].descriptorCount = 1;
-		descriptorWrites[1].pImageInfo = &imageInfo;
-
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), 
-			descriptorWrites.data(), 0, nullptr);
-	}
-
 private:
 	VKBuilder() { }
 };
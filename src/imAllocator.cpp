@@ -0,0 +1,201 @@
+#include "imAllocator.h"
+#include "imBuffer.h"
+
+imAllocator allocator;
+
+/// Round 'value' up to the next multiple of 'alignment'.
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+imAllocation imAllocator::Allocate(const VkMemoryRequirements &reqs,
+		VkMemoryPropertyFlags properties, bool linear) {
+	uint32_t memoryType = FindMemoryType(reqs.memoryTypeBits, properties);
+	imAllocation allocation;
+
+	// First fit over every existing block of a compatible type.
+	for (uint32_t i = 0; i < blocks.size(); i++) {
+		Block &block = blocks[i];
+		if (block.memory == VK_NULL_HANDLE || block.memoryType != memoryType
+				|| block.linear != linear) {
+			continue;
+		}
+
+		if (AllocateFromBlock(block, i, reqs, allocation)) {
+			return allocation;
+		}
+	}
+
+	// Nothing fits, reserve a new block. Anything larger than half
+	// a block gets a block of its own rather than wasting the remainder.
+	bool dedicated = reqs.size > IM_ALLOCATOR_BLOCK_SIZE / 2;
+	VkDeviceSize blockSize = dedicated ? reqs.size : IM_ALLOCATOR_BLOCK_SIZE;
+
+	uint32_t index = CreateBlock(memoryType, blockSize, linear, dedicated);
+	if (!AllocateFromBlock(blocks[index], index, reqs, allocation)) {
+		throw std::runtime_error("Failed to sub-allocate from a new memory block!");
+	}
+
+	return allocation;
+}
+
+void imAllocator::Free(imAllocation &allocation) {
+	if (allocation.memory == VK_NULL_HANDLE) { return; }
+
+	Block &block = blocks[allocation.block];
+	FreeRange range = { allocation.offset, allocation.size };
+
+	// Insert in offset order then merge with our neighbours.
+	auto it = block.freeList.begin();
+	while (it != block.freeList.end() && it->offset < range.offset) { it++; }
+	it = block.freeList.insert(it, range);
+
+	auto next = it + 1;
+	if (next != block.freeList.end() && it->offset + it->size == next->offset) {
+		it->size += next->size;
+		block.freeList.erase(next);
+	}
+
+	if (it != block.freeList.begin()) {
+		auto prev = it - 1;
+		if (prev->offset + prev->size == it->offset) {
+			prev->size += it->size;
+			block.freeList.erase(it);
+		}
+	}
+
+	block.used -= allocation.size;
+	block.allocationCount--;
+
+	// Dedicated blocks are unlikely to be reused, give them back to the driver.
+	if (block.allocationCount == 0 && block.dedicated) {
+		vkFreeMemory(device, block.memory, nullptr);
+		block = Block();
+	}
+
+	allocation = imAllocation();
+}
+
+void imAllocator::PrintStats() {
+	std::cout << "Device Memory Blocks:" << std::endl;
+
+	for (uint32_t i = 0; i < blocks.size(); i++) {
+		const Block &block = blocks[i];
+		if (block.memory == VK_NULL_HANDLE) { continue; }
+
+		VkDeviceSize largestFree = 0;
+		for (const auto &range : block.freeList) {
+			largestFree = std::max(largestFree, range.size);
+		}
+
+		// 0% means all free memory is one contiguous range.
+		VkDeviceSize totalFree = block.size - block.used;
+		float fragmentation = totalFree > 0 ?
+			1.0f - (float)largestFree / (float)totalFree : 0.0f;
+
+		std::cout << "\t- Block " << i << " (type " << block.memoryType
+			<< (block.linear ? ", linear" : ", optimal") << "): "
+			<< block.used / 1024 << "/" << block.size / 1024 << " KiB used, "
+			<< block.allocationCount << " allocations, "
+			<< block.freeList.size() << " free ranges, "
+			<< (int)(fragmentation * 100.0f) << "% fragmented" << std::endl;
+	}
+
+	std::cout << "-----------------------------------------------" << std::endl;
+}
+
+void imAllocator::Cleanup() {
+	for (auto &block : blocks) {
+		if (block.memory == VK_NULL_HANDLE) { continue; }
+
+		if (block.allocationCount > 0) {
+			std::cerr << "Freeing memory block with " << block.allocationCount
+				<< " live allocations!" << std::endl;
+		}
+
+		vkFreeMemory(device, block.memory, nullptr);
+	}
+
+	blocks.clear();
+}
+
+bool imAllocator::AllocateFromBlock(Block &block, uint32_t index,
+		const VkMemoryRequirements &reqs, imAllocation &allocation) {
+	for (size_t i = 0; i < block.freeList.size(); i++) {
+		FreeRange range = block.freeList[i];
+		VkDeviceSize offset = AlignUp(range.offset, reqs.alignment);
+		VkDeviceSize padding = offset - range.offset;
+
+		if (padding + reqs.size > range.size) { continue; }
+
+		// Split the range into (padding, allocation, remainder).
+		block.freeList.erase(block.freeList.begin() + i);
+		VkDeviceSize remainder = range.size - padding - reqs.size;
+		if (remainder > 0) {
+			block.freeList.insert(block.freeList.begin() + i,
+				{ offset + reqs.size, remainder });
+		}
+
+		if (padding > 0) {
+			block.freeList.insert(block.freeList.begin() + i,
+				{ range.offset, padding });
+		}
+
+		block.used += reqs.size;
+		block.allocationCount++;
+
+		allocation.memory = block.memory;
+		allocation.offset = offset;
+		allocation.size = reqs.size;
+		allocation.memoryType = block.memoryType;
+		allocation.block = index;
+		allocation.mapped = block.mapped ?
+			static_cast<char *>(block.mapped) + offset : nullptr;
+
+		return true;
+	}
+
+	return false;
+}
+
+uint32_t imAllocator::CreateBlock(uint32_t memoryType, VkDeviceSize size, bool linear,
+		bool dedicated) {
+	VkMemoryAllocateInfo allocInfo = { };
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryType;
+
+	Block block;
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate device memory block!");
+	}
+
+	block.size = size;
+	block.memoryType = memoryType;
+	block.linear = linear;
+	block.dedicated = dedicated;
+	block.freeList.push_back({ 0, size });
+
+	// Host visible blocks stay mapped for their whole lifetime,
+	// vkMapMemory can only be called once per VkDeviceMemory anyway.
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+	if (memProperties.memoryTypes[memoryType].propertyFlags
+			& VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(device, block.memory, 0, size, 0, &block.mapped) != VK_SUCCESS) {
+			vkFreeMemory(device, block.memory, nullptr);
+			throw std::runtime_error("Failed to map device memory block!");
+		}
+	}
+
+	// Reuse the slot of a released dedicated block if there is one.
+	for (uint32_t i = 0; i < blocks.size(); i++) {
+		if (blocks[i].memory == VK_NULL_HANDLE) {
+			blocks[i] = block;
+			return i;
+		}
+	}
+
+	blocks.push_back(block);
+	return static_cast<uint32_t>(blocks.size() - 1);
+}
@@ -0,0 +1,77 @@
+#ifndef IM_ALLOCATOR_H
+#define IM_ALLOCATOR_H
+
+#include "imVulkan.h"
+
+/// Default size of each VkDeviceMemory block reserved by the allocator.
+const VkDeviceSize IM_ALLOCATOR_BLOCK_SIZE = 64 * 1024 * 1024;
+
+/// A region of device memory sub-allocated from one of the allocator's blocks.
+/// Bind resources to 'memory' at 'offset', never at 0.
+struct imAllocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	/// Host pointer to the start of this allocation, nullptr if not host visible.
+	void * mapped = nullptr;
+
+	uint32_t memoryType = 0;
+	uint32_t block = 0;
+};
+
+/// Reserves large VkDeviceMemory blocks per memory type and hands out
+/// aligned sub-ranges of them, so we stay well clear of maxMemoryAllocationCount.
+class imAllocator {
+public:
+	/// Sub-allocate memory matching the given requirements and properties.
+	/// 'linear' should be true for buffers and linear images, false for
+	/// optimally tiled images. The two never share a block, which keeps us
+	/// from ever violating bufferImageGranularity.
+	imAllocation Allocate(const VkMemoryRequirements &reqs,
+		VkMemoryPropertyFlags properties, bool linear);
+
+	/// Return the range to its block's free list.
+	void Free(imAllocation &allocation);
+
+	/// Print the usage and fragmentation of every block.
+	void PrintStats();
+
+	/// Release every block, all resources must have been freed already.
+	void Cleanup();
+
+private:
+	/// Contiguous range of unused memory within a block.
+	struct FreeRange {
+		VkDeviceSize offset;
+		VkDeviceSize size;
+	};
+
+	struct Block {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		VkDeviceSize used = 0;
+		uint32_t memoryType = 0;
+		bool linear = true;
+		/// Sized for a single large allocation, released once that is freed.
+		bool dedicated = false;
+		/// Persistently mapped pointer for host visible blocks.
+		void * mapped = nullptr;
+		/// Sorted by offset, neighbouring ranges are always merged.
+		std::vector<FreeRange> freeList;
+		uint32_t allocationCount = 0;
+	};
+
+	bool AllocateFromBlock(Block &block, uint32_t index,
+		const VkMemoryRequirements &reqs, imAllocation &allocation);
+	uint32_t CreateBlock(uint32_t memoryType, VkDeviceSize size, bool linear,
+		bool dedicated);
+
+	/// Blocks are never erased so an allocation's block index stays valid,
+	/// empty dedicated blocks are released and left as VK_NULL_HANDLE for reuse.
+	std::vector<Block> blocks;
+};
+
+/// Global allocator shared by every buffer and image in the application.
+extern imAllocator allocator;
+
+#endif
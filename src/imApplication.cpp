@@ -1,6 +1,8 @@
 #include "imApplication.h"
 #include "VKBuilder.hpp"
 
+#include <algorithm>
+
 imApplication::imApplication(size_t screen_w, size_t screen_h, const char * app_name) {
 	InitGLFW(screen_w, screen_h, app_name);
 	InitVulkan();
@@ -14,11 +16,6 @@ void imApplication::Run() {
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
 		Update();
-		// Validation layers require GPU/CPU synchronization.
-		// Synchronize after running update code, rather then before,
-		// that way can delay synchronization as long as possible.
-		if (VALIDATION_LAYERS_ENABLED) { vkDeviceWaitIdle(device); }
-		UpdateUniformBuffer();
 		DrawFrame();
 	}
 
@@ -26,10 +23,12 @@ void imApplication::Run() {
 }
 
 void imApplication::Update() {
-	// TODO
+	// Hand any finished uploads over to the graphics queue.
+	stagingRing.Update();
+	textureLoader.Update();
 }
 
-void imApplication::UpdateUniformBuffer() {
+uint32_t imApplication::UpdateUniformBuffer() {
 	// Compute the total runtime of this application.
 	static auto startTime = std::chrono::high_resolution_clock::now();
 	auto currentTime = std::chrono::high_resolution_clock::now();
@@ -42,27 +41,82 @@ void imApplication::UpdateUniformBuffer() {
 	ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f),
 		glm::vec3(0.0f, 0.0f, 1.0f));
 	// look position, camera position, up vector
-	ubo.view = glm::lookAt(glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 0.0f, 0.0f),
+	glm::vec3 eye(1.0f, 1.0f, 1.0f);
+	ubo.view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f),
 		glm::vec3(0.0f, 0.0f, 1.0f));
 	// projection matrix with 45 degrees of FOV, swap chain aspect ratio, near
 	// plan and far plane distances.
 	ubo.proj = glm::perspective(glm::radians(45.0f), swapchain.extent.width /
 		(float)swapchain.extent.height, 0.1f, 10.0f);
+
+	// Every copy shares the texture, so it needs the detail of the nearest
+	// one, which lies right below the camera since the grid spans the view.
+	// Its projected diameter is the pixels the streamer has to cover.
+	float diameter = 2.0f * mesh.bounds.w * INSTANCE_SCALE * INSTANCE_EXTENT / INSTANCE_GRID;
+	float distance = std::max(eye.z - diameter * 0.5f, 0.1f);
+	textureLoader.Demand(texture, diameter * ubo.proj[1][1] * 0.5f *
+		swapchain.extent.height / distance);
+
 	// OpenGL -> Vulkan space conversion.
 	ubo.proj[1][1] *= -1;
 
-	// Now we can transfer this data to the GPU.
-	void * data;
-	vkMapMemory(device, uniformBufferMemory, 0, sizeof(ubo), 0, &data);
-	memcpy(data, &ubo, sizeof(ubo));
-	vkUnmapMemory(device, uniformBufferMemory);
+	cullMatrix = ubo.proj * ubo.view * ubo.model;
+
+	// The ring is persistently mapped, so this is just a bump and a copy.
+	return uniformRing.Push(ubo);
+}
+
+void imApplication::CreateInstances() {
+	std::vector<imCullObject> objects;
+	objects.reserve(INSTANCE_GRID * INSTANCE_GRID);
+
+	// Lay the copies out on a grid in the xy plane, wider than the view so
+	// that culling has something to reject, tinted by their grid position.
+	float spacing = INSTANCE_EXTENT / INSTANCE_GRID;
+	for (uint32_t y = 0; y < INSTANCE_GRID; y++) {
+		for (uint32_t x = 0; x < INSTANCE_GRID; x++) {
+			glm::vec3 pos(spacing * (x + 0.5f), spacing * (y + 0.5f), 0.0f);
+			pos -= glm::vec3(INSTANCE_EXTENT * 0.5f, INSTANCE_EXTENT * 0.5f, 0.0f);
+
+			imCullObject object = { };
+			object.transform = glm::scale(glm::translate(glm::mat4(1.0f), pos), 
+				glm::vec3(spacing * INSTANCE_SCALE));
+			object.params = glm::vec4((float)x / INSTANCE_GRID, 
+				(float)y / INSTANCE_GRID, 1.0f, 1.0f);
+			object.bounds = mesh.bounds;
+			object.drawGroup = 0;
+			objects.push_back(object);
+		}
+	}
+
+	imDrawGroup group = { mesh.indexCount, 0, 0 };
+	cullPass.SetObjects(objects, { group });
 }
 
 void imApplication::DrawFrame() {
+	imFrame &frame = frames[currentFrame];
+
+	// Only block if the GPU is still working on the last use of this frame,
+	// i.e. MAX_FRAMES_IN_FLIGHT frames behind the CPU.
+	vkWaitForFences(device, 1, &frame.inFlightFence, VK_TRUE, 
+		std::numeric_limits<uint64_t>::max());
+	swapchain.ReleaseRetired(frameNumber);
+
+	// A frame boundary, so swap in any pipelines rebuilt from edited shaders.
+	for (const std::string &file : shaderWatcher.Changed()) {
+		pipeline.Reload(file);
+	}
+	if (pipeline.Update(frameNumber) > 0) {
+		meshPipelineHandle = VK_NULL_HANDLE;
+	}
+	bindlessTextures.Update(frameNumber);
+	textureStreamer.Update(frameNumber);
+	descriptorCache.Update(frameNumber);
+
 	uint32_t imageIndex;
 	VkResult result = vkAcquireNextImageKHR(device, swapchain.swapChain, 
 		std::numeric_limits<uint64_t>::max(),
-		imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+		frame.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
 
 	// Check if Vulkan thiks we need to recreate our swap chain.
 	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
@@ -72,11 +126,24 @@ void imApplication::DrawFrame() {
 		throw std::runtime_error("Failed to acquire swap chain image!");
 	}
 
+	// The swap chain may hand out images out of order, so another frame
+	// might still be rendering to this one.
+	if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
+		vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE,
+			std::numeric_limits<uint64_t>::max());
+	}
+	imagesInFlight[imageIndex] = frame.inFlightFence;
+
+	// The GPU is done with this frame's resources, safe to overwrite them.
+	uniformRing.BeginFrame(currentFrame);
+	uint32_t uboOffset = UpdateUniformBuffer();
+	RecordCommandBuffer(frame, imageIndex, uboOffset);
+
 	VkSubmitInfo submitInfo = { };
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	// If we need, we can wait for more than one semaphore to become available.
 	VkSemaphore waitSemaphores[] = {
-		imageAvailableSemaphore
+		frame.imageAvailableSemaphore
 	};
 	VkPipelineStageFlags waitStages[] = {
 		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
@@ -88,15 +155,18 @@ void imApplication::DrawFrame() {
 	submitInfo.pWaitDstStageMask = waitStages;
 	// We only have a single command buffer to run.
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+	submitInfo.pCommandBuffers = &frame.commandBuffer;
 	// Unlock the render finished semaphore once our commands have all finished.
-	VkSemaphore signalSemaphores[] = { renderFinishedSemaphore };
+	VkSemaphore signalSemaphores[] = { frame.renderFinishedSemaphore };
 	submitInfo.signalSemaphoreCount = 1;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
-	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+	// The fence is signalled once this frame's resources are free again.
+	vkResetFences(device, 1, &frame.inFlightFence);
+	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, frame.inFlightFence) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to submit draw command buffer!");
 	}
+	frameNumber++;
 
 	// --- Presentation ---
 	
@@ -113,11 +183,15 @@ void imApplication::DrawFrame() {
 
 	result = vkQueuePresentKHR(presentQueue, &presentInfo);
 
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || 
+			framebufferResized) {
+		framebufferResized = false;
 		RecreateSwapChain();
 	} else if (result != VK_SUCCESS) {
 		throw std::runtime_error("Failed to present swap chain image!");
 	}
+
+	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
 void imApplication::InitGLFW(size_t screen_w, size_t screen_h, const char * app_name) {
@@ -126,7 +200,7 @@ void imApplication::InitGLFW(size_t screen_w, size_t screen_h, const char * app_
 	window = glfwCreateWindow(screen_w, screen_h, app_name, nullptr, nullptr);
 
 	glfwSetWindowUserPointer(window, this);
-	glfwSetWindowSizeCallback(window, imApplication::OnWindowResized);
+	glfwSetFramebufferSizeCallback(window, imApplication::OnWindowResized);
 }
 
 void imApplication::InitVulkan() {
@@ -136,81 +210,273 @@ void imApplication::InitVulkan() {
 	VKBuilder::CreateSurface();
 	VKDebug::SetupDebugCallback(callback);
 	VKBuilder::SelectPhysicalDevice();
-	VKBuilder::CreateLogicalDevice(graphicsQueue, presentQueue);
+	VKBuilder::CreateLogicalDevice(graphicsQueue, presentQueue, transferQueue);
+	pipelineCache.Create();
+	threadPool.Create();
+	bindlessTextures.Create();
 
 	// Setup the swap chain and graphics pipeline.
 	swapchain.CreateSwapChain();
 	swapchain.CreateImageViews();
 	pipeline.CreateRenderPass(swapchain.imageFormat);
-	VKBuilder::CreateDescriptorSetLayout(descriptorSetLayout);
-	pipeline.CreateGraphicsPipeline(swapchain.extent, 
-		"shaders/vert.spv", "shaders/frag.spv", descriptorSetLayout);
+	// The bindless shader reads its texture from the table by index,
+	// its layout has no sampler binding of its own.
+	meshPipeline = pipeline.Describe("shaders/vert.spv", bindlessTextures.enabled
+		? "shaders/frag_bindless.spv" : "shaders/frag.spv");
+	meshPipeline.Specialize(IM_SPEC_TEXTURED, true)
+		.Specialize(IM_SPEC_VERTEX_COLOR, false)
+		.Specialize(IM_SPEC_TINT_STRENGTH, 1.0f);
+	descriptorSetLayout = layoutCache.SetLayouts(meshPipeline.layout)[0];
+	// Compiles on a worker while we load the mesh and texture,
+	// the first frame waits for it if it isn't done by then.
+	pipeline.Request(meshPipeline);
+
+	if (SHADER_HOT_RELOAD_ENABLED) {
+		// GLSL sources and the SPIR-V the glsl make target builds from them.
+		shaderWatcher.Start("shaders", {
+			{ "shader.vert", "vert.spv" },
+			{ "shader.frag", "frag.spv" },
+			{ "bindless.frag", "frag_bindless.spv" }
+		});
+	}
 
 	// Create the command buffers for submitting commands.
 	VKBuilder::CreateCommandPoool(commandPool);
+	oneTimeCommands.Create();
+	stagingRing.Create();
+	textureLoader.Create();
+	uniformRing.Create(sizeof(UniformBufferObject));
 	mesh.Create();
+	cullPass.Create("shaders/cull.spv");
+	CreateInstances();
 	swapchain.CreateDepthBuffer();
 	swapchain.CreateFrameBuffers(pipeline.renderPass);
-	image.Create("tex/caco.png");
-	VKBuilder::CreateUniformBuffer(uniformBuffer, uniformBufferMemory);
-	VKBuilder::CreateDescriptorPool(descriptorPool);
-	VKBuilder::CreateDescriptorSet(descriptorPool, descriptorSet, 
-		uniformBuffer, descriptorSetLayout, image);
+	// Prefer the cooked texture, see 'make textures'. It decodes on the
+	// thread pool, the mesh draws with the placeholder until its tail is
+	// resident, and finer levels stream in as the demand asks for them.
+	texture = textureLoader.Load(std::ifstream("tex/caco.ktx2").good() 
+		? "tex/caco.ktx2" : "tex/caco.png", true, true);
+	// Submit every mesh upload and the placeholder as a single batch, which
+	// runs on the transfer queue while we finish setting up.
+	imUploadToken uploads = stagingRing.Flush();
 	CreateCommandBuffers();
-	InitSemaphores();
+	InitSyncObjects();
+
+	// Every transition recorded during setup goes out in one submission,
+	// and the first frame draws the mesh, so it must be resident by then.
+	oneTimeCommands.Flush(true);
+	stagingRing.Wait(uploads);
+	oneTimeCommands.PrintStats();
+	stagingRing.PrintStats();
+	pipelineCache.PrintStats();
+	pipeline.PrintStats();
+	layoutCache.PrintStats();
+	bindlessTextures.PrintStats();
 }
 
-void imApplication::CleanupSwapChain() {
-	vkFreeCommandBuffers(device, commandPool, 
-		static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
-	pipeline.Cleanup();
-	swapchain.Cleanup();
+std::vector<imPipelineDesc> imApplication::MaterialVariants() {
+	std::vector<imPipelineDesc> variants;
+
+	const VkCullModeFlags cullModes[] = {
+		VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT, VK_CULL_MODE_BACK_BIT
+	};
+	const VkCompareOp compareOps[] = {
+		VK_COMPARE_OP_LESS, VK_COMPARE_OP_LESS_OR_EQUAL,
+		VK_COMPARE_OP_GREATER, VK_COMPARE_OP_ALWAYS
+	};
+	const VkFrontFace frontFaces[] = {
+		VK_FRONT_FACE_COUNTER_CLOCKWISE, VK_FRONT_FACE_CLOCKWISE
+	};
+
+	for (VkCullModeFlags cullMode : cullModes) {
+		for (VkCompareOp compareOp : compareOps) {
+			for (VkFrontFace frontFace : frontFaces) {
+				// Each bit toggles one more state: depth write, blending, alpha
+				// write, then the texturing and vertex color shader features.
+				for (int flags = 0; flags < 32; flags++) {
+					imPipelineDesc desc = meshPipeline;
+					desc.cullMode = cullMode;
+					desc.depthCompareOp = compareOp;
+					desc.frontFace = frontFace;
+					desc.depthWrite = (flags & 1) ? VK_FALSE : VK_TRUE;
+
+					if (flags & 2) {
+						desc.blendEnable = VK_TRUE;
+						desc.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+						desc.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+					}
+
+					if (flags & 4) {
+						desc.colorWriteMask = VK_COLOR_COMPONENT_R_BIT 
+							| VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT;
+					}
+
+					desc.Specialize(IM_SPEC_TEXTURED, (flags & 8) == 0);
+					desc.Specialize(IM_SPEC_VERTEX_COLOR, (flags & 16) != 0);
+					variants.push_back(desc);
+				}
+			}
+		}
+	}
+
+	return variants;
 }
 
-void imApplication::RecreateSwapChain() {
-	vkDeviceWaitIdle(device);
+void imApplication::BenchmarkPipelines() {
+	std::vector<imPipelineDesc> variants = MaterialVariants();
+
+	// Bypass the disk cache so every run compiles from scratch, and load the
+	// shader modules beforehand so only pipeline creation is timed. Note
+	// some drivers keep their own shader cache, which may still help.
+	pipeline.usePipelineCache = false;
+	pipeline.Get(meshPipeline);
+
+	std::vector<uint32_t> threadCounts;
+	uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	for (uint32_t count = 1; count < maxThreads; count *= 2) {
+		threadCounts.push_back(count);
+	}
+	threadCounts.push_back(maxThreads);
 
-	std::cout << "Recreating Swap Chain" << std::endl;
+	std::cout << "Compiling " << variants.size() << " pipeline variants" << std::endl;
 	std::cout << "-----------------------------------------------" << std::endl;
-	CleanupSwapChain();
 
-	swapchain.CreateSwapChain();
-	swapchain.CreateImageViews();
-	pipeline.CreateRenderPass(swapchain.imageFormat);
-	pipeline.CreateGraphicsPipeline(swapchain.extent, 
-		"shaders/vert.spv", "shaders/frag.spv", descriptorSetLayout);
-	swapchain.CreateDepthBuffer();
-	swapchain.CreateFrameBuffers(pipeline.renderPass);
-	CreateCommandBuffers();
+	// Serial on the main thread, as startup used to do it.
+	pipeline.DestroyPipelines();
+	auto start = std::chrono::high_resolution_clock::now();
+	for (auto &desc : variants) {
+		pipeline.Get(desc);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	double serialTime = std::chrono::duration<double, std::milli>(end - start).count();
+	std::cout << "\t- main thread: " << serialTime << " ms" << std::endl;
+
+	for (uint32_t count : threadCounts) {
+		imThreadPool pool;
+		pool.Create(count);
+		pipeline.DestroyPipelines();
+
+		start = std::chrono::high_resolution_clock::now();
+		for (auto &desc : variants) {
+			pipeline.Request(desc, pool);
+		}
+		pipeline.WaitIdle();
+		end = std::chrono::high_resolution_clock::now();
+
+		pool.Cleanup();
+		double time = std::chrono::duration<double, std::milli>(end - start).count();
+		std::cout << "\t- " << count << " thread" << (count == 1 ? "" : "s") << ": " 
+			<< time << " ms (" << serialTime / time << "x)" << std::endl;
+	}
+
+	std::cout << "-----------------------------------------------" << std::endl;
+	pipeline.DestroyPipelines();
+	pipeline.usePipelineCache = true;
+}
+
+void imApplication::RecreateSwapChain() {
+	// A minimized window has nothing to render to, wait until it is restored.
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(window, &width, &height);
+	while (width == 0 || height == 0) {
+		glfwWaitEvents();
+		glfwGetFramebufferSize(window, &width, &height);
+	}
+
+	// Update our global constants for the screen size.
+	SCREENW = width;
+	SCREENH = height;
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	// Only objects sized to the swap chain are replaced, the old ones are
+	// retired until the frames still in flight have finished with them.
+	VkFormat format = swapchain.QuerySurfaceFormat();
+	if (format != swapchain.imageFormat) {
+		// Rare, the render pass and pipeline depend on the image format, and
+		// the new frame buffers must be built against the new render pass.
+		vkDeviceWaitIdle(device);
+		pipeline.DestroyPipelines();
+		vkDestroyRenderPass(device, pipeline.renderPass, nullptr);
+		pipeline.CreateRenderPass(format);
+		meshPipeline.renderPass = pipeline.renderPass;
+		meshPipelineHandle = pipeline.Get(meshPipeline);
+	}
+
+	swapchain.Recreate(pipeline.renderPass, frameNumber);
+
+	imagesInFlight.assign(swapchain.images.size(), VK_NULL_HANDLE);
+	// Submitted ahead of the next frame on the same queue, no need to wait.
+	oneTimeCommands.Flush(false);
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	std::cout << "Recreated Swap Chain (" << swapchain.extent.width << "x" 
+		<< swapchain.extent.height << ") in " 
+		<< std::chrono::duration<double, std::milli>(endTime - startTime).count() 
+		<< " ms" << std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
 }
 
-void imApplication::InitSemaphores() {
+void imApplication::InitSyncObjects() {
 	VkSemaphoreCreateInfo semaphoreInfo = { };
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphore) 
-			!= VK_SUCCESS || 
-		vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore) 
-			!= VK_SUCCESS) {
-		throw std::runtime_error("Failed to create semaphores!");
+	// Start signalled, so the first wait on each frame returns immediately.
+	VkFenceCreateInfo fenceInfo = { };
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	for (auto &frame : frames) {
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, 
+				&frame.imageAvailableSemaphore) != VK_SUCCESS || 
+			vkCreateSemaphore(device, &semaphoreInfo, nullptr, 
+				&frame.renderFinishedSemaphore) != VK_SUCCESS ||
+			vkCreateFence(device, &fenceInfo, nullptr, &frame.inFlightFence) 
+				!= VK_SUCCESS) {
+			throw std::runtime_error("Failed to create frame synchronization objects!");
+		}
 	}
+
+	imagesInFlight.assign(swapchain.images.size(), VK_NULL_HANDLE);
 }
 
 void imApplication::Cleanup() {
 	// Vulkan
 	
-	CleanupSwapChain();
+	shaderWatcher.Stop();
+	pipeline.PrintStats();
+	pipeline.Cleanup();
+	threadPool.Cleanup();
+	swapchain.Cleanup();
+	oneTimeCommands.Cleanup();
+	stagingRing.Cleanup();
+	uniformRing.Cleanup();
+	cullPass.PrintStats();
+	cullPass.Cleanup();
 	mesh.Cleanup();
-	image.Cleanup();
+	textureLoader.PrintStats();
+	textureLoader.Cleanup();
+	textureStreamer.PrintStats();
+	textureStreamer.Cleanup();
+	bindlessTextures.Cleanup();
+	samplerCache.PrintStats();
+	samplerCache.Cleanup();
+
+	descriptorCache.PrintStats();
+	descriptorCache.Cleanup();
+	layoutCache.Cleanup();
+
+	for (auto &frame : frames) {
+		vkDestroySemaphore(device, frame.renderFinishedSemaphore, nullptr);
+		vkDestroySemaphore(device, frame.imageAvailableSemaphore, nullptr);
+		vkDestroyFence(device, frame.inFlightFence, nullptr);
+	}
 
-	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-	vkDestroyBuffer(device, uniformBuffer, nullptr);
-	vkFreeMemory(device, uniformBufferMemory, nullptr);
+	allocator.PrintStats();
+	allocator.Cleanup();
 	
-	vkDestroySemaphore(device, renderFinishedSemaphore, nullptr);
-	vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
 	vkDestroyCommandPool(device, commandPool, nullptr);
+	pipelineCache.Cleanup();
 	
 	if (VALIDATION_LAYERS_ENABLED) {
 		VKDebug::DestroyDebugReportCallbackEXT(callback, nullptr);
@@ -226,19 +492,15 @@ void imApplication::Cleanup() {
 }
 
 void imApplication::OnWindowResized(GLFWwindow * window, int width, int height) {
-	if (window == 0 || height == 0) { return; }
-
-	// Update our global constants for the screen size.
-	SCREENH = width;
-	SCREENW = width;
-
+	// Recreated by the next frame, so a drag that fires many events
+	// only rebuilds once per frame.
 	imApplication * app = reinterpret_cast<imApplication *>(
 		glfwGetWindowUserPointer(window));
-	app->RecreateSwapChain();
+	app->framebufferResized = true;
 }
 
 void imApplication::CreateCommandBuffers() {
-	commandBuffers.resize(swapchain.frameBuffers.size());
+	std::array<VkCommandBuffer, MAX_FRAMES_IN_FLIGHT> commandBuffers;
 
 	VkCommandBufferAllocateInfo allocInfo = { };
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -251,54 +513,83 @@ void imApplication::CreateCommandBuffers() {
 		throw std::runtime_error("Failed to create command buffers!");
 	}
 
-	for (size_t i = 0; i < commandBuffers.size(); i++) {
-		VkCommandBufferBeginInfo beginInfo = { };
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-		beginInfo.pInheritanceInfo = nullptr; // Optional
-
-		// Begin recording to the command buffer (implicitly reset buffer).
-		vkBeginCommandBuffer(commandBuffers[i], &beginInfo);
-
-		VkRenderPassBeginInfo renderPassInfo = { };
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = pipeline.renderPass;
-		renderPassInfo.framebuffer = swapchain.frameBuffers[i];
-		renderPassInfo.renderArea.offset = { 0, 0 };
-		renderPassInfo.renderArea.extent = swapchain.extent;
-
-		std::array<VkClearValue, 2> clearValues;
-		clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-		clearValues[1].depthStencil = { 1.0f, 0 };
-
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());;
-		renderPassInfo.pClearValues = clearValues.data();
-
-		// Begin the render pass, can now submit drawing commands.
-		vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, 
-			VK_SUBPASS_CONTENTS_INLINE);
-
-		vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, 
-			pipeline.pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-		vkCmdBindPipeline(commandBuffers[i], 
-			VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.graphicsPipeline);
-
-		// Bind the vertex buffer for rendering.
-		VkBuffer vertexBuffers[] = { mesh.vertexBuffer };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(commandBuffers[i], mesh.indexBuffer, 
-			0, VK_INDEX_TYPE_UINT16);
-
-		vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(INDICES.size()),
-			1, 0, 0, 0);
-
-		// End the render pass, stop submitting draw commands.
-		vkCmdEndRenderPass(commandBuffers[i]);
-
-		// Stop recording to the command buffer.
-		if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to record command buffer!");
-		}
+	for (size_t i = 0; i < frames.size(); i++) {
+		frames[i].commandBuffer = commandBuffers[i];
+	}
+}
+
+void imApplication::RecordCommandBuffer(imFrame &frame, uint32_t imageIndex,
+		uint32_t uboOffset) {
+	VkCommandBuffer commandBuffer = frame.commandBuffer;
+
+	VkCommandBufferBeginInfo beginInfo = { };
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = nullptr; // Optional
+
+	// Begin recording to the command buffer (implicitly reset buffer).
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	// Decide what to draw on the GPU before the render pass begins.
+	cullPass.Record(commandBuffer, currentFrame, cullMatrix);
+
+	VkRenderPassBeginInfo renderPassInfo = { };
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = pipeline.renderPass;
+	renderPassInfo.framebuffer = swapchain.frameBuffers[imageIndex];
+	renderPassInfo.renderArea.offset = { 0, 0 };
+	renderPassInfo.renderArea.extent = swapchain.extent;
+
+	std::array<VkClearValue, 2> clearValues;
+	clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+	clearValues[1].depthStencil = { 1.0f, 0 };
+
+	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());;
+	renderPassInfo.pClearValues = clearValues.data();
+
+	// Begin the render pass, can now submit drawing commands.
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, 
+		VK_SUBPASS_CONTENTS_INLINE);
+
+	// Maps the uniform ring and texture to the bindings. The ubo binding is
+	// dynamic, so the same cached set serves every frame and every object.
+	std::vector<imDescriptorWrite> writes = {
+		imDescriptorWrite::Buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+			uniformRing.buffer, 0, sizeof(UniformBufferObject))
+	};
+	const imImage &image = textureLoader.Get(texture);
+	if (!bindlessTextures.enabled) {
+		writes.push_back(imDescriptorWrite::Image(1, 
+			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, image.view, image.sampler));
+	}
+	VkDescriptorSet descriptorSet = descriptorCache.Get(descriptorSetLayout, writes);
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
+		meshPipeline.layout, 0, 1, &descriptorSet, 1, &uboOffset);
+
+	if (bindlessTextures.enabled) {
+		// Every texture is in the one table, the draw picks its own by index.
+		bindlessTextures.Bind(commandBuffer, meshPipeline.layout, 1);
+		uint32_t textureIndex = textureLoader.BindlessIndex(texture);
+		vkCmdPushConstants(commandBuffer, meshPipeline.layout, 
+			VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(textureIndex), &textureIndex);
+	}
+	// Only looked up again after a reload or a new render pass.
+	if (meshPipelineHandle == VK_NULL_HANDLE) {
+		meshPipelineHandle = pipeline.Get(meshPipeline);
+	}
+	vkCmdBindPipeline(commandBuffer, 
+		VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipelineHandle);
+	imPipeline::SetViewport(commandBuffer, swapchain.extent);
+
+	// Every visible copy of the mesh goes out in a single indirect draw.
+	cullPass.Draw(commandBuffer, currentFrame, mesh);
+
+	// End the render pass, stop submitting draw commands.
+	vkCmdEndRenderPass(commandBuffer);
+
+	// Stop recording to the command buffer.
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to record command buffer!");
 	}
 }
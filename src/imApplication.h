@@ -6,8 +6,40 @@
 
 #include "imMesh.h"
 #include "imImage.h"
+#include "imStagingRing.h"
+#include "imCommandContext.h"
+#include "imUniformRing.h"
+#include "imCullPass.h"
+#include "imPipelineCache.h"
+#include "imLayoutCache.h"
 #include "imPipeline.h"
+#include "imThreadPool.h"
+#include "imShaderWatcher.h"
 #include "imSwapChain.h"
+#include "imDescriptorCache.h"
+#include "imSamplerCache.h"
+#include "imBindlessTextures.h"
+#include "imTextureLoader.h"
+
+/// Resources owned by a single frame in flight, none of these may be
+/// touched by the CPU until the frame's fence has signalled.
+struct imFrame {
+	/// Re-recorded every time this frame is drawn.
+	VkCommandBuffer commandBuffer;
+	/// Holds rendering until an image is ready to render to.
+	VkSemaphore imageAvailableSemaphore;
+	/// Holds presentation until we are finished rendering.
+	VkSemaphore renderFinishedSemaphore;
+	/// Signalled once the GPU has finished with this frame.
+	VkFence inFlightFence;
+};
+
+/// Number of mesh copies along each side of the instanced grid.
+const uint32_t INSTANCE_GRID = 320;
+/// Width of the instanced grid in world units.
+const float INSTANCE_EXTENT = 8.0f;
+/// Scale of each copy relative to the grid spacing.
+const float INSTANCE_SCALE = 0.8f;
 
 class imApplication {
 public:
@@ -28,51 +60,70 @@ public:
 	 */
 	void Run();
 
+	/**
+	 * Compile a few hundred pipeline variants serially and on thread
+	 * pools of increasing size, printing the wall time of each.
+	 */
+	void BenchmarkPipelines();
+
 private:
 	void InitGLFW(size_t screen_w, size_t screen_h, const char * app_name);
 	void InitVulkan();
-	void InitSemaphores();
+	void InitSyncObjects();
 
-	void CleanupSwapChain();
+	/// Rebuild the swap chain and everything sized to it, without waiting
+	/// for the device to go idle.
 	void RecreateSwapChain();
 
 	static void OnWindowResized(GLFWwindow * window, int width, int height);
 
 	void Update();
-	void UpdateUniformBuffer();
+	uint32_t UpdateUniformBuffer();
 	void DrawFrame();
 	void Cleanup();
 
+	/// Variations of 'meshPipeline' standing in for a large set of materials.
+	std::vector<imPipelineDesc> MaterialVariants();
+
+	/// Hand a grid of copies of the mesh to the culling pass.
+	void CreateInstances();
 	void CreateCommandBuffers();
+	void RecordCommandBuffer(imFrame &frame, uint32_t imageIndex, uint32_t uboOffset);
 
 	/// Will hold a basic configuration for our graphics pipeline.
 	imPipeline pipeline;
+	/// State of the pipeline the mesh is drawn with, looked up in 'pipeline'.
+	imPipelineDesc meshPipeline;
+	/// 'meshPipeline' as last looked up, null whenever a reload or a new
+	/// render pass may have replaced it, so frames don't each hash the desc.
+	VkPipeline meshPipelineHandle = VK_NULL_HANDLE;
 	/// Will hold a basic configuratio for our swap chain.
 	imSwapChain swapchain;
 
-	/// Describes the bindings within the shader.
+	/// Describes the bindings within the shader, reflected from its SPIR-V
+	/// and owned by the layout cache.
 	VkDescriptorSetLayout descriptorSetLayout;
-	/// The pool from which we can allocate descriptor sets.
-	VkDescriptorPool descriptorPool;
-	/// Set of descriptors describing mapping of the ubo to the bindings.
-	VkDescriptorSet descriptorSet;
-	/// Describes the buffer storing the vertex transformation matrices.
-	VkBuffer uniformBuffer;
-	/// Allocated GPU memory for storing the vertex transformation matrices.
-	VkDeviceMemory uniformBufferMemory;
 
 	/// Stores mesh data we wish to render.
 	imMesh mesh;
-	/// Stores the image to map to the mesh.
-	imImage image;
-
-	/// We need one command buffer for each framebuffer in the swap chain.
-	std::vector<VkCommandBuffer> commandBuffers;
-
-	/// Holds rendering until an image is ready to render to.
-	VkSemaphore imageAvailableSemaphore;
-	/// Holds presentation until we are finished rendering.
-	VkSemaphore renderFinishedSemaphore;
+	/// Texture mapped to the mesh, the loader's placeholder until resident.
+	imTextureHandle texture;
+	/// Culls the copies of the mesh on the GPU and draws the survivors.
+	imCullPass cullPass;
+	/// Clip space transform of the current frame, used to cull against.
+	glm::mat4 cullMatrix;
+
+	/// Per frame resources, cycled through so the CPU can work on one
+	/// frame while the GPU is still rendering the previous ones.
+	std::array<imFrame, MAX_FRAMES_IN_FLIGHT> frames;
+	/// Index into 'frames' of the frame being prepared.
+	size_t currentFrame = 0;
+	/// Total number of frames submitted.
+	uint64_t frameNumber = 0;
+	/// Set by the resize callback, handled after the next present.
+	bool framebufferResized = false;
+	/// Fence of the frame last rendered to each swap chain image, if any.
+	std::vector<VkFence> imagesInFlight;
 
 	/// Handle to validation layers debug callback.
 	VkDebugReportCallbackEXT callback;
@@ -0,0 +1,138 @@
+#include "imBindlessTextures.h"
+#include "imLayoutCache.h"
+
+imBindlessTextures bindlessTextures;
+
+void imBindlessTextures::Create() {
+	if (!descriptorIndexingSupported) {
+		std::cout << "Descriptor indexing is unsupported, bindless textures are disabled."
+			<< std::endl;
+		std::cout << "-----------------------------------------------" << std::endl;
+		return;
+	}
+
+	// Goes through the layout cache, so pipelines reflected from shaders
+	// declaring the same array share this exact layout.
+	VkDescriptorSetLayoutBinding binding = { };
+	binding.binding = BINDLESS_TEXTURE_BINDING;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	binding.descriptorCount = 0;
+	binding.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+	layout = layoutCache.GetSetLayout({ binding });
+
+	VkDescriptorPoolSize poolSize = { };
+	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSize.descriptorCount = RUNTIME_ARRAY_SIZE;
+
+	VkDescriptorPoolCreateInfo poolInfo = { };
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = 1;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create bindless descriptor pool!");
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = { };
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate bindless descriptor set!");
+	}
+
+	enabled = true;
+}
+
+uint32_t imBindlessTextures::Register(const imImage &image) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	uint32_t index;
+	if (!freeSlots.empty()) {
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	} else if (highWater < RUNTIME_ARRAY_SIZE) {
+		index = highWater++;
+	} else {
+		throw std::runtime_error("Bindless texture table is full!");
+	}
+
+	VkDescriptorImageInfo imageInfo = { };
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = image.view;
+	imageInfo.sampler = image.sampler;
+
+	// No frame in flight reads this slot, so unlike a regular set this
+	// needs no waiting, see VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT.
+	VkWriteDescriptorSet write = { };
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = BINDLESS_TEXTURE_BINDING;
+	write.dstArrayElement = index;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.descriptorCount = 1;
+	write.pImageInfo = &imageInfo;
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+	registered++;
+	return index;
+}
+
+void imBindlessTextures::Unregister(uint32_t index) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// The stale descriptor is harmless, the binding is partially bound.
+	Retired slot;
+	slot.index = index;
+	slot.frame = frameNumber;
+	retired.push_back(slot);
+	registered--;
+}
+
+void imBindlessTextures::Update(uint64_t frameNumber) {
+	std::lock_guard<std::mutex> lock(mutex);
+	this->frameNumber = frameNumber;
+
+	for (auto it = retired.begin(); it != retired.end(); ) {
+		if (frameNumber >= it->frame + MAX_FRAMES_IN_FLIGHT) {
+			freeSlots.push_back(it->index);
+			it = retired.erase(it);
+		} else {
+			it++;
+		}
+	}
+}
+
+void imBindlessTextures::Bind(VkCommandBuffer commandBuffer, VkPipelineLayout layout,
+		uint32_t set) {
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+		layout, set, 1, &this->set, 0, nullptr);
+}
+
+void imBindlessTextures::PrintStats() {
+	if (!enabled) {
+		return;
+	}
+
+	std::cout << "Bindless Textures: " << registered << " of " << RUNTIME_ARRAY_SIZE
+		<< " slots in use, " << highWater << " ever used" << std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
+}
+
+void imBindlessTextures::Cleanup() {
+	if (pool != VK_NULL_HANDLE) {
+		vkDestroyDescriptorPool(device, pool, nullptr);
+		pool = VK_NULL_HANDLE;
+	}
+
+	set = VK_NULL_HANDLE;
+	highWater = 0;
+	registered = 0;
+	freeSlots.clear();
+	retired.clear();
+	enabled = false;
+}
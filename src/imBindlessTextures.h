@@ -0,0 +1,68 @@
+#ifndef IM_BINDLESS_TEXTURES_H
+#define IM_BINDLESS_TEXTURES_H
+
+#include "imVulkan.h"
+#include "imImage.h"
+
+#include <mutex>
+
+/// Binding within 'set' holding the texture array.
+const uint32_t BINDLESS_TEXTURE_BINDING = 0;
+
+/// One large array of combined image samplers that every texture registers
+/// into, bound once per frame as a descriptor set of its own. Shaders pick a
+/// texture by its index in the array, so drawing with any number of textures
+/// takes no further descriptor sets or binds. Needs descriptor indexing,
+/// Create() leaves 'enabled' false on devices without it.
+class imBindlessTextures {
+public:
+	/// Allocate the table, its layout is the one shaders declaring
+	/// 'sampler2D textures[]' at BINDLESS_TEXTURE_BINDING reflect to.
+	void Create();
+
+	/// Write 'image' into a free slot, returning the index shaders read it at.
+	/// Safe to call while frames using the table are in flight.
+	uint32_t Register(const imImage &image);
+	/// Free the slot at 'index', it is reused once no frame in flight can
+	/// still read it. The image may be destroyed once no frame draws with it.
+	void Unregister(uint32_t index);
+	/// Recycle slots freed MAX_FRAMES_IN_FLIGHT frames ago, once per frame.
+	void Update(uint64_t frameNumber);
+
+	/// Bind the table as set 'set' of 'layout'.
+	void Bind(VkCommandBuffer commandBuffer, VkPipelineLayout layout, uint32_t set);
+
+	/// Print how many slots are in use.
+	void PrintStats();
+	void Cleanup();
+
+	/// True if the device supports bindless textures and Create() was called.
+	bool enabled = false;
+	/// Owned by the layout cache.
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+	VkDescriptorSet set = VK_NULL_HANDLE;
+
+private:
+	/// A freed slot, and the frame it was freed during.
+	struct Retired {
+		uint32_t index;
+		uint64_t frame;
+	};
+
+	/// Guards everything below, textures may register from any thread.
+	std::mutex mutex;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	/// Slots below this have been handed out at least once.
+	uint32_t highWater = 0;
+	std::vector<uint32_t> freeSlots;
+	std::vector<Retired> retired;
+	/// Frame last passed to Update().
+	uint64_t frameNumber = 0;
+	/// Slots currently registered.
+	uint32_t registered = 0;
+};
+
+/// Global bindless texture table.
+extern imBindlessTextures bindlessTextures;
+
+#endif
@@ -0,0 +1,360 @@
+#include "imBlockEncoder.h"
+
+#include <cmath>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+	#define IM_BLOCK_X86
+	#include <emmintrin.h>
+#endif
+
+/// Interpolation weights of BC7's 4 bit indices, out of 64.
+static const int BC7_WEIGHTS[16] = {
+	0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64
+};
+
+/// Texels of one block by channel, the layout both kernels read.
+struct imBlockTexels {
+	float channel[4][16];
+};
+
+/// Colors a block's texels may take, one row per index.
+struct imBlockPalette {
+	float entry[16][4];
+	uint32_t count;
+};
+
+/// Nearest palette entry of each texel over the first 'channels' channels,
+/// ties go to the lower index.
+static void SelectIndicesScalar(const imBlockTexels &texels, const imBlockPalette &palette,
+		uint32_t channels, uint8_t * indices) {
+	for (uint32_t i = 0; i < 16; i++) {
+		float best = std::numeric_limits<float>::max();
+		for (uint32_t k = 0; k < palette.count; k++) {
+			float distance = 0.0f;
+			for (uint32_t c = 0; c < channels; c++) {
+				float d = texels.channel[c][i] - palette.entry[k][c];
+				distance += d * d;
+			}
+
+			if (distance < best) {
+				best = distance;
+				indices[i] = static_cast<uint8_t>(k);
+			}
+		}
+	}
+}
+
+#ifdef IM_BLOCK_X86
+
+static void SelectIndicesSSE(const imBlockTexels &texels, const imBlockPalette &palette,
+		uint32_t channels, uint8_t * indices) {
+	for (uint32_t i = 0; i < 16; i += 4) {
+		__m128 best = _mm_set1_ps(std::numeric_limits<float>::max());
+		__m128i bestIndex = _mm_setzero_si128();
+
+		for (uint32_t k = 0; k < palette.count; k++) {
+			// Distances are sums of squared integers, exact in any order, so
+			// these match the scalar kernel bit for bit.
+			__m128 distance = _mm_setzero_ps();
+			for (uint32_t c = 0; c < channels; c++) {
+				__m128 d = _mm_sub_ps(_mm_loadu_ps(&texels.channel[c][i]),
+					_mm_set1_ps(palette.entry[k][c]));
+				distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+			}
+
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+			best = _mm_min_ps(distance, best);
+			bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)),
+				_mm_andnot_si128(closer, bestIndex));
+		}
+
+		alignas(16) int32_t lanes[4];
+		_mm_store_si128(reinterpret_cast<__m128i *>(lanes), bestIndex);
+		for (uint32_t lane = 0; lane < 4; lane++) {
+			indices[i + lane] = static_cast<uint8_t>(lanes[lane]);
+		}
+	}
+}
+
+#endif
+
+static void SelectIndices(const imBlockTexels &texels, const imBlockPalette &palette,
+		uint32_t channels, uint8_t * indices, imBlockPath path) {
+#ifdef IM_BLOCK_X86
+	if (path == IM_BLOCK_SSE) {
+		SelectIndicesSSE(texels, palette, channels, indices);
+		return;
+	}
+#endif
+
+	SelectIndicesScalar(texels, palette, channels, indices);
+}
+
+/// Ends of the line through the block's first 'channels' channels along
+/// which they vary most, found by power iteration on their covariance.
+static void FitEndpoints(const imBlockTexels &texels, uint32_t channels,
+		float * low, float * high) {
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (uint32_t c = 0; c < channels; c++) {
+		float minimum = 255.0f;
+		float maximum = 0.0f;
+		for (uint32_t i = 0; i < 16; i++) {
+			mean[c] += texels.channel[c][i];
+			minimum = std::min(minimum, texels.channel[c][i]);
+			maximum = std::max(maximum, texels.channel[c][i]);
+		}
+
+		mean[c] /= 16.0f;
+		// The bounding box diagonal is a good first guess.
+		axis[c] = maximum - minimum;
+	}
+
+	float covariance[4][4] = { };
+	for (uint32_t a = 0; a < channels; a++) {
+		for (uint32_t b = 0; b < channels; b++) {
+			for (uint32_t i = 0; i < 16; i++) {
+				covariance[a][b] += (texels.channel[a][i] - mean[a]) *
+					(texels.channel[b][i] - mean[b]);
+			}
+		}
+	}
+
+	for (int iteration = 0; iteration < 8; iteration++) {
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float length = 0.0f;
+		for (uint32_t a = 0; a < channels; a++) {
+			for (uint32_t b = 0; b < channels; b++) {
+				next[a] += covariance[a][b] * axis[b];
+			}
+
+			length += next[a] * next[a];
+		}
+
+		// A flat block has no axis, both ends sit on the mean.
+		if (length < 1e-6f) {
+			break;
+		}
+
+		length = std::sqrt(length);
+		for (uint32_t c = 0; c < channels; c++) {
+			axis[c] = next[c] / length;
+		}
+	}
+
+	float minimum = 0.0f;
+	float maximum = 0.0f;
+	for (uint32_t i = 0; i < 16; i++) {
+		float t = 0.0f;
+		for (uint32_t c = 0; c < channels; c++) {
+			t += (texels.channel[c][i] - mean[c]) * axis[c];
+		}
+
+		minimum = std::min(minimum, t);
+		maximum = std::max(maximum, t);
+	}
+
+	for (uint32_t c = 0; c < channels; c++) {
+		low[c] = std::min(std::max(mean[c] + axis[c] * minimum, 0.0f), 255.0f);
+		high[c] = std::min(std::max(mean[c] + axis[c] * maximum, 0.0f), 255.0f);
+	}
+}
+
+/// 8 bit value of a 'bits' wide channel, as the GPU expands it.
+static int Expand(int value, int bits) {
+	return (value << (8 - bits)) | (value >> (2 * bits - 8));
+}
+
+static uint16_t Pack565(const float * color) {
+	int r = static_cast<int>(std::lrint(color[0] * 31.0f / 255.0f));
+	int g = static_cast<int>(std::lrint(color[1] * 63.0f / 255.0f));
+	int b = static_cast<int>(std::lrint(color[2] * 31.0f / 255.0f));
+	return static_cast<uint16_t>(r << 11 | g << 5 | b);
+}
+
+static void Unpack565(uint16_t packed, float * color) {
+	color[0] = static_cast<float>(Expand(packed >> 11 & 31, 5));
+	color[1] = static_cast<float>(Expand(packed >> 5 & 63, 6));
+	color[2] = static_cast<float>(Expand(packed & 31, 5));
+	color[3] = 255.0f;
+}
+
+static void EncodeBC1(const imBlockTexels &texels, uint8_t * out, imBlockPath path) {
+	float low[4], high[4];
+	FitEndpoints(texels, 3, low, high);
+
+	// The larger endpoint goes first, selecting the four color mode.
+	uint16_t color0 = Pack565(high);
+	uint16_t color1 = Pack565(low);
+	if (color0 < color1) {
+		std::swap(color0, color1);
+	}
+
+	uint8_t indices[16] = { };
+	if (color0 != color1) {
+		imBlockPalette palette;
+		palette.count = 4;
+		Unpack565(color0, palette.entry[0]);
+		Unpack565(color1, palette.entry[1]);
+		for (uint32_t c = 0; c < 3; c++) {
+			float a = palette.entry[0][c];
+			float b = palette.entry[1][c];
+			palette.entry[2][c] = (2.0f * a + b) / 3.0f;
+			palette.entry[3][c] = (a + 2.0f * b) / 3.0f;
+		}
+
+		SelectIndices(texels, palette, 3, indices, path);
+	}
+
+	uint32_t bits = 0;
+	for (uint32_t i = 0; i < 16; i++) {
+		bits |= static_cast<uint32_t>(indices[i]) << (2 * i);
+	}
+
+	out[0] = color0 & 0xFF;
+	out[1] = color0 >> 8;
+	out[2] = color1 & 0xFF;
+	out[3] = color1 >> 8;
+	for (uint32_t i = 0; i < 4; i++) {
+		out[4 + i] = bits >> (8 * i) & 0xFF;
+	}
+}
+
+/// Writes fields into a block from its least significant bit up.
+struct imBitWriter {
+	uint8_t * out;
+	uint32_t position;
+
+	void Put(uint32_t value, uint32_t bits) {
+		for (uint32_t i = 0; i < bits; i++, position++) {
+			out[position / 8] |= ((value >> i) & 1) << (position % 8);
+		}
+	}
+};
+
+/// 7 bit endpoint and shared low bit closest to an 8 bit RGBA 'color'.
+static void QuantizeBC7(const float * color, int * quantized, int &pBit) {
+	float bestError = std::numeric_limits<float>::max();
+	for (int p = 0; p < 2; p++) {
+		int candidate[4];
+		float error = 0.0f;
+		for (uint32_t c = 0; c < 4; c++) {
+			candidate[c] = std::min(std::max(
+				static_cast<int>(std::lrint((color[c] - p) / 2.0f)), 0), 127);
+			float d = static_cast<float>(candidate[c] * 2 + p) - color[c];
+			error += d * d;
+		}
+
+		if (error < bestError) {
+			bestError = error;
+			pBit = p;
+			std::copy(candidate, candidate + 4, quantized);
+		}
+	}
+}
+
+static void EncodeBC7(const imBlockTexels &texels, uint8_t * out, imBlockPath path) {
+	float low[4], high[4];
+	FitEndpoints(texels, 4, low, high);
+
+	// Mode 6, a single subset of 7 bit RGBA endpoints and 4 bit indices.
+	int endpoint[2][4];
+	int pBit[2];
+	QuantizeBC7(low, endpoint[0], pBit[0]);
+	QuantizeBC7(high, endpoint[1], pBit[1]);
+
+	imBlockPalette palette;
+	palette.count = 16;
+	for (uint32_t k = 0; k < 16; k++) {
+		for (uint32_t c = 0; c < 4; c++) {
+			int e0 = endpoint[0][c] * 2 + pBit[0];
+			int e1 = endpoint[1][c] * 2 + pBit[1];
+			palette.entry[k][c] = static_cast<float>(
+				((64 - BC7_WEIGHTS[k]) * e0 + BC7_WEIGHTS[k] * e1 + 32) >> 6);
+		}
+	}
+
+	uint8_t indices[16];
+	SelectIndices(texels, palette, 4, indices, path);
+
+	// The first index drops its top bit, so it must be below 8.
+	if (indices[0] >= 8) {
+		std::swap(endpoint[0], endpoint[1]);
+		std::swap(pBit[0], pBit[1]);
+		for (uint8_t &index : indices) {
+			index = 15 - index;
+		}
+	}
+
+	memset(out, 0, 16);
+	imBitWriter writer = { out, 0 };
+	writer.Put(1 << 6, 7);
+	for (uint32_t c = 0; c < 4; c++) {
+		writer.Put(endpoint[0][c], 7);
+		writer.Put(endpoint[1][c], 7);
+	}
+
+	writer.Put(pBit[0], 1);
+	writer.Put(pBit[1], 1);
+	writer.Put(indices[0], 3);
+	for (uint32_t i = 1; i < 16; i++) {
+		writer.Put(indices[i], 4);
+	}
+}
+
+void imBlockEncoder::EncodeBlock(imBlockFormat format, const uint8_t * texels,
+		uint8_t * out, imBlockPath path) {
+	// Never run a kernel this CPU can't execute.
+	if (path == IM_BLOCK_BEST || path > BestPath()) {
+		path = BestPath();
+	}
+
+	imBlockTexels block;
+	for (uint32_t i = 0; i < 16; i++) {
+		for (uint32_t c = 0; c < 4; c++) {
+			block.channel[c][i] = texels[i * 4 + c];
+		}
+	}
+
+	if (format == IM_BLOCK_BC1) {
+		EncodeBC1(block, out, path);
+	} else {
+		EncodeBC7(block, out, path);
+	}
+}
+
+void imBlockEncoder::EncodeRows(imBlockFormat format, const uint8_t * pixels,
+		uint32_t width, uint32_t height, uint32_t firstRow, uint32_t lastRow,
+		uint8_t * out, imBlockPath path) {
+	uint32_t blocksWide = std::max((width + 3) / 4, 1u);
+	size_t blockBytes = BlockBytes(format);
+
+	for (uint32_t row = firstRow; row < lastRow; row++) {
+		for (uint32_t column = 0; column < blocksWide; column++) {
+			uint8_t texels[64];
+			for (uint32_t y = 0; y < 4; y++) {
+				uint32_t sy = std::min(row * 4 + y, height - 1);
+				for (uint32_t x = 0; x < 4; x++) {
+					uint32_t sx = std::min(column * 4 + x, width - 1);
+					memcpy(texels + (y * 4 + x) * 4,
+						pixels + (static_cast<size_t>(sy) * width + sx) * 4, 4);
+				}
+			}
+
+			EncodeBlock(format, texels,
+				out + (static_cast<size_t>(row) * blocksWide + column) * blockBytes, path);
+		}
+	}
+}
+
+size_t imBlockEncoder::BlockBytes(imBlockFormat format) {
+	return format == IM_BLOCK_BC1 ? 8 : 16;
+}
+
+imBlockPath imBlockEncoder::BestPath() {
+#ifdef IM_BLOCK_X86
+	return IM_BLOCK_SSE;
+#else
+	return IM_BLOCK_SCALAR;
+#endif
+}
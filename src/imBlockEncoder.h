@@ -0,0 +1,54 @@
+#ifndef IM_BLOCK_ENCODER_H
+#define IM_BLOCK_ENCODER_H
+
+#include "PREFIX.h"
+
+#include <algorithm>
+
+/// Kernel used to pick the palette entry of each texel in a block.
+enum imBlockPath {
+	/// Reference implementation, one texel at a time.
+	IM_BLOCK_SCALAR,
+	/// Four texels at once.
+	IM_BLOCK_SSE,
+	/// Widest kernel the running CPU supports.
+	IM_BLOCK_BEST
+};
+
+/// Block compression formats imBlockEncoder writes.
+enum imBlockFormat {
+	/// 8 bytes per block, opaque color only.
+	IM_BLOCK_BC1,
+	/// 16 bytes per block, color and alpha, written as BC7 mode 6.
+	IM_BLOCK_BC7
+};
+
+/// Encodes RGBA8 images into BC1 or BC7 blocks, fast enough for an offline
+/// cooker rather than tuned for the best possible quality. Endpoints come
+/// from the block's principal axis, then every texel takes its nearest
+/// palette entry. Texels are encoded as stored, so sRGB images are fitted
+/// in gamma space like most encoders do.
+class imBlockEncoder {
+public:
+	/// Encode one block of 16 RGBA8 texels, row by row, into 'out'.
+	static void EncodeBlock(imBlockFormat format, const uint8_t * texels, uint8_t * out,
+		imBlockPath path = IM_BLOCK_BEST);
+
+	/// Encode rows of blocks 'firstRow' to 'lastRow' (exclusive) of a tightly
+	/// packed image into 'out', which holds the whole level. Edge blocks
+	/// repeat the last row and column. Rows are independent, so a level
+	/// can be split between threads.
+	static void EncodeRows(imBlockFormat format, const uint8_t * pixels,
+		uint32_t width, uint32_t height, uint32_t firstRow, uint32_t lastRow,
+		uint8_t * out, imBlockPath path = IM_BLOCK_BEST);
+
+	/// Bytes in one block of 'format'.
+	static size_t BlockBytes(imBlockFormat format);
+	/// Rows of blocks in an image 'height' texels tall.
+	static uint32_t BlockRows(uint32_t height) { return std::max((height + 3) / 4, 1u); }
+
+	/// Widest kernel the running CPU supports.
+	static imBlockPath BestPath();
+};
+
+#endif
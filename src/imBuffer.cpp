@@ -1,4 +1,6 @@
 #include "imBuffer.h"
+#include "imCommandContext.h"
+#include "imDescriptorCache.h"
 
 /// Find a memory type that fits the input needs for our physical device.
 uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
@@ -19,7 +21,7 @@ uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
 /// Create a new buffer on the GPU using the given ubuffer usage and memory properties.
 void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, 
 		VkMemoryPropertyFlags properties, 
-		VkBuffer &buffer, VkDeviceMemory &bufferMemory) {
+		VkBuffer &buffer, imAllocation &bufferMemory) {
 	VkBufferCreateInfo bufferInfo = { };
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.size = size;
@@ -33,29 +35,27 @@ void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
 	VkMemoryRequirements memReqs;
 	vkGetBufferMemoryRequirements(device, buffer, &memReqs);
 
-	VkMemoryAllocateInfo allocInfo = { };
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memReqs.size;
-	allocInfo.memoryTypeIndex = FindMemoryType(memReqs.memoryTypeBits, 
-		properties);
-
-	if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to allocate buffer memory!");
-	}
+	bufferMemory = allocator.Allocate(memReqs, properties, true);
+	vkBindBufferMemory(device, buffer, bufferMemory.memory, bufferMemory.offset);
+}
 
-	vkBindBufferMemory(device, buffer, bufferMemory, 0);
+/// Destroy a buffer created with CreateBuffer and release its memory.
+void DestroyBuffer(VkBuffer &buffer, imAllocation &bufferMemory) {
+	descriptorCache.Forget(buffer);
+	vkDestroyBuffer(device, buffer, nullptr);
+	allocator.Free(bufferMemory);
+	buffer = VK_NULL_HANDLE;
 }
 
 /// Copy 'size' bytes from the source buffer into the destination buffer.
-/// Note: This is a device -> device memory transfer operation.
+/// Note: This is a device -> device memory transfer operation, recorded
+/// into the one time command context and executed on its next flush.
 void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-	VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
+	VkCommandBuffer commandBuffer = oneTimeCommands.Record();
 
 	VkBufferCopy copyRegion = { };
 	copyRegion.srcOffset = 0; // Optional
 	copyRegion.dstOffset = 0; // Optional
 	copyRegion.size = size;
 	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-	EndSingleTimeCommands(commandBuffer);
 }
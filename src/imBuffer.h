@@ -2,17 +2,23 @@
 #define IM_BUFFER_H
 
 #include "imVulkan.h"
+#include "imAllocator.h"
 
 /// Find a memory type that fits the input needs for our physical device.
 uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
 /// Create a new buffer on the GPU using the given ubuffer usage and memory properties.
+/// The backing memory is sub-allocated from the global allocator.
 void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, 
 		VkMemoryPropertyFlags properties, 
-		VkBuffer &buffer, VkDeviceMemory &bufferMemory);
+		VkBuffer &buffer, imAllocation &bufferMemory);
+
+/// Destroy a buffer created with CreateBuffer and release its memory.
+void DestroyBuffer(VkBuffer &buffer, imAllocation &bufferMemory);
 
 /// Copy 'size' bytes from the source buffer into the destination buffer.
-/// Note: This is a device -> device memory transfer operation.
+/// Note: This is a device -> device memory transfer operation, recorded
+/// into the one time command context and executed on its next flush.
 void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 
 #endif
@@ -0,0 +1,130 @@
+#include "imCommandContext.h"
+
+imCommandContext oneTimeCommands;
+
+void imCommandContext::Create() {
+	QueueFamilyIndices indices = FindQueueFamilies(physicalDevice, surface);
+
+	// Recorded buffers are reset individually once their fence signals.
+	VkCommandPoolCreateInfo poolInfo = { };
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = indices.graphicsFamily;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+		VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create one time command pool!");
+	}
+}
+
+VkCommandBuffer imCommandContext::Record() {
+	recordCount++;
+	if (recording.commandBuffer != VK_NULL_HANDLE) {
+		return recording.commandBuffer;
+	}
+
+	Recycle(false);
+
+	if (!freeSubmissions.empty()) {
+		recording = freeSubmissions.back();
+		freeSubmissions.pop_back();
+	} else {
+		VkCommandBufferAllocateInfo allocInfo = { };
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = pool;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(device, &allocInfo, &recording.commandBuffer)
+				!= VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate one time command buffer!");
+		}
+
+		VkFenceCreateInfo fenceInfo = { };
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		if (vkCreateFence(device, &fenceInfo, nullptr, &recording.fence) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create one time command fence!");
+		}
+	}
+
+	VkCommandBufferBeginInfo beginInfo = { };
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(recording.commandBuffer, &beginInfo);
+
+	return recording.commandBuffer;
+}
+
+void imCommandContext::Flush(bool wait) {
+	if (recording.commandBuffer != VK_NULL_HANDLE) {
+		// Transitions carry their own barriers, but copies do not, so
+		// make every transfer write visible to whatever is submitted next.
+		VkMemoryBarrier barrier = { };
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+
+		vkCmdPipelineBarrier(recording.commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		if (vkEndCommandBuffer(recording.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record one time command buffer!");
+		}
+
+		VkSubmitInfo submitInfo = { };
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &recording.commandBuffer;
+
+		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, recording.fence) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit one time command buffer!");
+		}
+
+		inFlight.push_back(recording);
+		recording = Submission();
+
+		totalRecords += recordCount;
+		totalSubmissions++;
+		recordCount = 0;
+	}
+
+	Recycle(wait);
+}
+
+void imCommandContext::PrintStats() {
+	std::cout << "One Time Commands: " << totalRecords << " recorded in "
+		<< totalSubmissions << " submission" << (totalSubmissions == 1 ? "" : "s")
+		<< std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
+}
+
+void imCommandContext::Cleanup() {
+	Flush(true);
+
+	for (auto &submission : freeSubmissions) {
+		vkDestroyFence(device, submission.fence, nullptr);
+	}
+
+	freeSubmissions.clear();
+	vkDestroyCommandPool(device, pool, nullptr);
+}
+
+void imCommandContext::Recycle(bool wait) {
+	while (!inFlight.empty()) {
+		Submission &submission = inFlight.front();
+
+		if (wait) {
+			vkWaitForFences(device, 1, &submission.fence, VK_TRUE,
+				std::numeric_limits<uint64_t>::max());
+		} else if (vkGetFenceStatus(device, submission.fence) != VK_SUCCESS) {
+			break;
+		}
+
+		vkResetFences(device, 1, &submission.fence);
+		vkResetCommandBuffer(submission.commandBuffer, 0);
+		freeSubmissions.push_back(submission);
+		inFlight.pop_front();
+	}
+}
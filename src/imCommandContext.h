@@ -0,0 +1,55 @@
+#ifndef IM_COMMAND_CONTEXT_H
+#define IM_COMMAND_CONTEXT_H
+
+#include "imVulkan.h"
+
+#include <deque>
+
+/// Collects one-off commands (layout transitions, copies, etc.) on the graphics
+/// queue into a single command buffer, which is submitted on Flush() and
+/// guarded by a fence. Command buffers are recycled once their fence signals.
+class imCommandContext {
+public:
+	/// Create the resettable command pool for the graphics queue family.
+	void Create();
+
+	/// Command buffer to record into, begun on first use after each flush.
+	/// Commands recorded here do not execute until the next Flush().
+	VkCommandBuffer Record();
+
+	/// Submit everything recorded since the last flush. If 'wait' is true,
+	/// block until every submission made by this context has finished.
+	void Flush(bool wait);
+
+	/// Print how many submissions were made and how many commands they batched.
+	void PrintStats();
+
+	/// Wait for outstanding submissions and release the pool.
+	void Cleanup();
+
+private:
+	struct Submission {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+	};
+
+	/// Return finished command buffers to the free list, or wait for all if 'wait'.
+	void Recycle(bool wait);
+
+	VkCommandPool pool = VK_NULL_HANDLE;
+	/// Submission currently being recorded, null until the first Record().
+	Submission recording;
+	/// Submitted, oldest first.
+	std::deque<Submission> inFlight;
+	/// Reset and ready to be recorded again.
+	std::vector<Submission> freeSubmissions;
+
+	uint32_t recordCount = 0;
+	uint32_t totalRecords = 0;
+	uint32_t totalSubmissions = 0;
+};
+
+/// Global context for one-off graphics queue work.
+extern imCommandContext oneTimeCommands;
+
+#endif
@@ -0,0 +1,233 @@
+#include "imCullPass.h"
+#include "imBuffer.h"
+#include "imPipeline.h"
+#include "imPipelineCache.h"
+#include "imStagingRing.h"
+#include "imFrustum.h"
+#include "imLayoutCache.h"
+
+#include <algorithm>
+
+/// Matches local_size_x in shaders/cull.comp.
+static const uint32_t CULL_GROUP_SIZE = 64;
+
+/// Push constant block of shaders/cull.comp.
+struct CullConstants {
+	glm::vec4 planes[6];
+	uint32_t objectCount;
+};
+
+void imCullPass::Create(const std::string &shaderFile) {
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+	multiDraw = features.multiDrawIndirect && features.drawIndirectFirstInstance;
+
+	// Objects, draw commands, visible instances and the visible count,
+	// plus the frustum push constants, all reflected from the shader.
+	std::vector<char> code = ReadFile(shaderFile);
+	imShaderReflection reflection;
+	reflection.Parse(code);
+
+	if (reflection.pushConstantSize > sizeof(CullConstants)) {
+		throw std::runtime_error("Culling shader push constants do not match CullConstants!");
+	}
+
+	pushConstantSize = reflection.pushConstantSize;
+	pipelineLayout = layoutCache.Get({ &reflection });
+	setLayout = layoutCache.SetLayouts(pipelineLayout).at(0);
+
+	VkShaderModule module = imPipeline::CreateShaderModule(code);
+
+	VkComputePipelineCreateInfo pipelineInfo = { };
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = module;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = pipelineLayout;
+
+	if (pipelineCache.CreateComputePipelines(1, &pipelineInfo, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create culling pipeline!");
+	}
+
+	vkDestroyShaderModule(device, module, nullptr);
+
+	// One set per frame in flight, written in SetObjects() and kept until Cleanup().
+	for (auto &frame : frames) {
+		frame.descriptorSet = descriptors.Allocate(setLayout);
+	}
+}
+
+void imCullPass::SetObjects(const std::vector<imCullObject> &objects,
+		const std::vector<imDrawGroup> &groups) {
+	if (groups.size() > 1 && !multiDraw) {
+		throw std::runtime_error(
+			"Multiple draw groups require multiDrawIndirect and drawIndirectFirstInstance!");
+	}
+
+	DestroyBuffers();
+	objectCount = static_cast<uint32_t>(objects.size());
+
+	// Give each group a contiguous range of the visible buffer, large
+	// enough for every object in the group to pass the cull.
+	std::vector<uint32_t> groupSizes(groups.size(), 0);
+	for (const auto &object : objects) {
+		if (object.drawGroup >= groups.size()) {
+			throw std::runtime_error("Culling object references an unknown draw group!");
+		}
+		groupSizes[object.drawGroup]++;
+	}
+
+	drawTemplate.resize(groups.size());
+	uint32_t firstInstance = 0;
+	for (size_t i = 0; i < groups.size(); i++) {
+		drawTemplate[i].indexCount = groups[i].indexCount;
+		drawTemplate[i].instanceCount = 0;
+		drawTemplate[i].firstIndex = groups[i].firstIndex;
+		drawTemplate[i].vertexOffset = groups[i].vertexOffset;
+		drawTemplate[i].firstInstance = firstInstance;
+		firstInstance += groupSizes[i];
+	}
+
+	if (objectCount == 0) {
+		return;
+	}
+
+	VkDeviceSize objectSize = sizeof(imCullObject) * objectCount;
+	CreateBuffer(objectSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		objectBuffer, objectMemory);
+	stagingRing.UploadBuffer(objectBuffer, objects.data(), objectSize);
+
+	for (auto &frame : frames) {
+		CreateBuffer(sizeof(VkDrawIndexedIndirectCommand) * drawTemplate.size(),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			frame.draws, frame.drawsMemory);
+		CreateBuffer(sizeof(imInstance) * objectCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.visible, frame.visibleMemory);
+		CreateBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			frame.stats, frame.statsMemory);
+		*static_cast<uint32_t *>(frame.statsMemory.mapped) = 0;
+	}
+
+	CreateDescriptors();
+}
+
+void imCullPass::CreateDescriptors() {
+	for (auto &frame : frames) {
+		std::array<VkDescriptorBufferInfo, 4> bufferInfo = { };
+		bufferInfo[0].buffer = objectBuffer;
+		bufferInfo[1].buffer = frame.draws;
+		bufferInfo[2].buffer = frame.visible;
+		bufferInfo[3].buffer = frame.stats;
+
+		std::array<VkWriteDescriptorSet, 4> writes = { };
+		for (uint32_t i = 0; i < writes.size(); i++) {
+			bufferInfo[i].offset = 0;
+			bufferInfo[i].range = VK_WHOLE_SIZE;
+
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = frame.descriptorSet;
+			writes[i].dstBinding = i;
+			writes[i].dstArrayElement = 0;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].descriptorCount = 1;
+			writes[i].pBufferInfo = &bufferInfo[i];
+		}
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()),
+			writes.data(), 0, nullptr);
+	}
+}
+
+void imCullPass::Record(VkCommandBuffer commandBuffer, size_t frameIndex,
+		const glm::mat4 &viewProj) {
+	if (objectCount == 0) {
+		return;
+	}
+
+	FrameBuffers &frame = frames[frameIndex];
+	lastFrame = frameIndex;
+
+	// The frame's fence has signalled, so the GPU is done with these. Host
+	// writes are made visible to the device by the submission itself.
+	memcpy(frame.drawsMemory.mapped, drawTemplate.data(),
+		sizeof(VkDrawIndexedIndirectCommand) * drawTemplate.size());
+	*static_cast<uint32_t *>(frame.statsMemory.mapped) = 0;
+
+	imFrustum frustum = imFrustum::FromMatrix(viewProj);
+
+	CullConstants constants;
+	std::copy(frustum.planes, frustum.planes + 6, constants.planes);
+	constants.objectCount = objectCount;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+		pipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+		0, pushConstantSize, &constants);
+	vkCmdDispatch(commandBuffer, (objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	// Draw commands and instances are consumed by the draw, the count by the host.
+	VkMemoryBarrier barrier = { };
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+		VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+		VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void imCullPass::Draw(VkCommandBuffer commandBuffer, size_t frameIndex, imMesh &mesh) {
+	if (objectCount == 0) {
+		return;
+	}
+
+	FrameBuffers &frame = frames[frameIndex];
+
+	VkBuffer vertexBuffers[] = { mesh.vertexBuffer, frame.visible };
+	VkDeviceSize offsets[] = { 0, 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+
+	// Groups with nothing visible have an instance count of 0 and cost nothing.
+	vkCmdDrawIndexedIndirect(commandBuffer, frame.draws, 0,
+		static_cast<uint32_t>(drawTemplate.size()), sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void imCullPass::PrintStats() {
+	uint32_t visible = 0;
+	if (objectCount > 0) {
+		visible = *static_cast<uint32_t *>(frames[lastFrame].statsMemory.mapped);
+	}
+
+	std::cout << "GPU Culling: " << visible << " of " << objectCount
+		<< " objects visible in " << drawTemplate.size() << " indirect draw"
+		<< (drawTemplate.size() == 1 ? "" : "s") << std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
+}
+
+void imCullPass::Cleanup() {
+	DestroyBuffers();
+
+	vkDestroyPipeline(device, pipeline, nullptr);
+	descriptors.Cleanup();
+}
+
+void imCullPass::DestroyBuffers() {
+	if (objectBuffer == VK_NULL_HANDLE) {
+		return;
+	}
+
+	DestroyBuffer(objectBuffer, objectMemory);
+	for (auto &frame : frames) {
+		DestroyBuffer(frame.draws, frame.drawsMemory);
+		DestroyBuffer(frame.visible, frame.visibleMemory);
+		DestroyBuffer(frame.stats, frame.statsMemory);
+	}
+}
@@ -0,0 +1,95 @@
+#ifndef IM_CULL_PASS_H
+#define IM_CULL_PASS_H
+
+#include "imVulkan.h"
+#include "imAllocator.h"
+#include "imMesh.h"
+#include "imDescriptorAllocator.h"
+
+/// Object fed to the culling pass, matches 'Object' in shaders/cull.comp.
+struct imCullObject {
+	glm::mat4 transform;
+	glm::vec4 params;
+	/// Bounding sphere in mesh space, xyz is the center and w the radius.
+	glm::vec4 bounds;
+	/// Index of the draw group this object is drawn with.
+	uint32_t drawGroup;
+	uint32_t padding[3];
+};
+
+/// Range of the shared vertex and index buffers drawn for one group of objects.
+struct imDrawGroup {
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+};
+
+/// GPU driven drawing. A compute pass tests every object's bounding sphere against
+/// the view frustum and appends the visible ones to a per-frame instance buffer,
+/// counting them into one VkDrawIndexedIndirectCommand per draw group. The frame
+/// then draws every group with a single vkCmdDrawIndexedIndirect, so the CPU cost
+/// of a frame does not grow with the number of objects.
+class imCullPass {
+public:
+	/// Create the compute pipeline from the given SPIR-V file.
+	void Create(const std::string &shaderFile);
+
+	/// Upload the objects through the staging ring and size the per-frame buffers.
+	/// Every group must index into the same vertex and index buffers. Must not be
+	/// called while a frame using this pass is in flight.
+	void SetObjects(const std::vector<imCullObject> &objects,
+		const std::vector<imDrawGroup> &groups);
+
+	/// Reset the frame's draw commands and record the culling dispatch, must be
+	/// recorded outside of a render pass once the frame's fence has signalled.
+	/// 'viewProj' takes object transforms to clip space.
+	void Record(VkCommandBuffer commandBuffer, size_t frameIndex, const glm::mat4 &viewProj);
+
+	/// Draw the objects that survived culling with the mesh's vertex and index buffers.
+	void Draw(VkCommandBuffer commandBuffer, size_t frameIndex, imMesh &mesh);
+
+	/// Print how many objects the last recorded frame drew, the device must be idle.
+	void PrintStats();
+
+	void Cleanup();
+
+	uint32_t objectCount = 0;
+
+private:
+	/// Everything the GPU writes while culling, one copy per frame in flight.
+	struct FrameBuffers {
+		/// Host visible, so the template can be rewritten every frame.
+		VkBuffer draws = VK_NULL_HANDLE;
+		imAllocation drawsMemory;
+		/// Compacted imInstance data for binding 1.
+		VkBuffer visible = VK_NULL_HANDLE;
+		imAllocation visibleMemory;
+		/// Number of visible objects, read back once the frame completes.
+		VkBuffer stats = VK_NULL_HANDLE;
+		imAllocation statsMemory;
+		VkDescriptorSet descriptorSet;
+	};
+
+	void CreateDescriptors();
+	void DestroyBuffers();
+
+	/// Both owned by the layout cache.
+	VkDescriptorSetLayout setLayout;
+	VkPipelineLayout pipelineLayout;
+	/// Bytes of CullConstants the shader declares, without the struct's tail padding.
+	uint32_t pushConstantSize = 0;
+	/// One set per frame in flight, allocated once.
+	imDescriptorAllocator descriptors;
+	VkPipeline pipeline;
+	/// True if every group can be drawn by a single indirect call.
+	bool multiDraw = false;
+
+	VkBuffer objectBuffer = VK_NULL_HANDLE;
+	imAllocation objectMemory;
+	std::array<FrameBuffers, MAX_FRAMES_IN_FLIGHT> frames;
+	/// Draw commands with zeroed instance counts, copied to a frame before culling.
+	std::vector<VkDrawIndexedIndirectCommand> drawTemplate;
+	size_t lastFrame = 0;
+};
+
+#endif
@@ -0,0 +1,145 @@
+#include "imDescriptorAllocator.h"
+
+#include <algorithm>
+
+/// Descriptors of each type per set in a pool. Generous for the types our
+/// shaders use, we can't know the layouts a pool will serve up front.
+static const struct {
+	VkDescriptorType type;
+	float perSet;
+} POOL_RATIOS[] = {
+	{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+	{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+	{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f },
+	{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f },
+	{ VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+	{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+	{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.5f }
+};
+
+VkDescriptorSet imDescriptorAllocator::Allocate(VkDescriptorSetLayout layout,
+		VkDescriptorPool * pool) {
+	VkDescriptorSetAllocateInfo allocInfo = { };
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+
+	VkDescriptorSet set;
+	while (true) {
+		if (current == VK_NULL_HANDLE) {
+			current = NextPool(currentCreated);
+		}
+
+		allocInfo.descriptorPool = current;
+		if (vkAllocateDescriptorSets(device, &allocInfo, &set) == VK_SUCCESS) {
+			break;
+		}
+
+		// Only failing in an empty pool is fatal.
+		if (currentCreated) {
+			throw std::runtime_error("Failed to allocate descriptor set!");
+		}
+
+		// The pool is full, or too fragmented. Older drivers report either
+		// as a generic out of memory error, so any failure moves on.
+		usedPools.push_back(current);
+		current = VK_NULL_HANDLE;
+	}
+
+	if (pool) {
+		*pool = current;
+	}
+
+	allocatedSets++;
+	return set;
+}
+
+void imDescriptorAllocator::Free(VkDescriptorSet set, VkDescriptorPool pool) {
+	vkFreeDescriptorSets(device, pool, 1, &set);
+	allocatedSets--;
+
+	// The pool has room again, so it is worth another try.
+	auto it = std::find(usedPools.begin(), usedPools.end(), pool);
+	if (it != usedPools.end()) {
+		usedPools.erase(it);
+		freePools.push_back(pool);
+	}
+}
+
+void imDescriptorAllocator::Reset() {
+	if (current != VK_NULL_HANDLE) {
+		usedPools.push_back(current);
+		current = VK_NULL_HANDLE;
+	}
+
+	for (VkDescriptorPool pool : usedPools) {
+		vkResetDescriptorPool(device, pool, 0);
+		freePools.push_back(pool);
+	}
+	usedPools.clear();
+
+	lastSets = allocatedSets;
+	peakSets = std::max(peakSets, allocatedSets);
+	allocatedSets = 0;
+}
+
+void imDescriptorAllocator::PrintStats(const std::string &name) {
+	std::cout << name << " Descriptors: " << PoolCount() << " pool"
+		<< (PoolCount() == 1 ? "" : "s") << ", " << lastSets << " sets last frame, "
+		<< std::max(peakSets, allocatedSets) << " at peak" << std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
+}
+
+void imDescriptorAllocator::Cleanup() {
+	Reset();
+
+	for (VkDescriptorPool pool : freePools) {
+		vkDestroyDescriptorPool(device, pool, nullptr);
+	}
+
+	freePools.clear();
+	nextPoolSets = DESCRIPTOR_POOL_MIN_SETS;
+}
+
+uint32_t imDescriptorAllocator::PoolCount() const {
+	return static_cast<uint32_t>(usedPools.size() + freePools.size()) +
+		(current != VK_NULL_HANDLE ? 1 : 0);
+}
+
+VkDescriptorPool imDescriptorAllocator::NextPool(bool &created) {
+	if (!freePools.empty()) {
+		VkDescriptorPool pool = freePools.back();
+		freePools.pop_back();
+		// Reset pools are as good as new, but freeable ones may be partly used.
+		created = false;
+		return pool;
+	}
+
+	uint32_t maxSets = nextPoolSets;
+	nextPoolSets = std::min(nextPoolSets * 2, DESCRIPTOR_POOL_MAX_SETS);
+
+	std::vector<VkDescriptorPoolSize> poolSizes;
+	for (const auto &ratio : POOL_RATIOS) {
+		VkDescriptorPoolSize poolSize = { };
+		poolSize.type = ratio.type;
+		poolSize.descriptorCount = std::max(1u, static_cast<uint32_t>(ratio.perSet * maxSets));
+		poolSizes.push_back(poolSize);
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo = { };
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = maxSets;
+	if (freeable) {
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	}
+
+	VkDescriptorPool pool;
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create descriptor pool!");
+	}
+
+	created = true;
+	return pool;
+}
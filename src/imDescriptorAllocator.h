@@ -0,0 +1,61 @@
+#ifndef IM_DESCRIPTOR_ALLOCATOR_H
+#define IM_DESCRIPTOR_ALLOCATOR_H
+
+#include "imVulkan.h"
+
+/// Sets in the first pool of each allocator, later pools double up to the max.
+const uint32_t DESCRIPTOR_POOL_MIN_SETS = 64;
+const uint32_t DESCRIPTOR_POOL_MAX_SETS = 4096;
+
+/// Allocates descriptor sets from a chain of pools, adding a pool whenever the
+/// current one runs out. Reset() returns every set at once and keeps the pools
+/// for reuse. Give each frame in flight its own allocator for transient sets,
+/// and reset it once the frame's fence has signalled. Long lived sets may
+/// instead be freed one by one, if 'freeable' is set before the first Allocate().
+class imDescriptorAllocator {
+public:
+	/// Allocate a set with the given layout, growing the chain if needed.
+	/// 'pool' is set to the pool it came from, which Free() needs.
+	VkDescriptorSet Allocate(VkDescriptorSetLayout layout, VkDescriptorPool * pool = nullptr);
+
+	/// Return a single set to 'pool', only valid if 'freeable'.
+	void Free(VkDescriptorSet set, VkDescriptorPool pool);
+
+	/// Reset every pool, invalidating all sets allocated from them.
+	void Reset();
+
+	/// Print the pool count and the sets allocated per reset.
+	void PrintStats(const std::string &name);
+
+	/// Destroy every pool.
+	void Cleanup();
+
+	/// Pools created so far, in use or not.
+	uint32_t PoolCount() const;
+
+	/// Sets allocated since the last Reset().
+	uint32_t allocatedSets = 0;
+	/// Sets allocated between the last two resets, i.e. by the last frame.
+	uint32_t lastSets = 0;
+	/// Most sets allocated between any two resets.
+	uint32_t peakSets = 0;
+	/// Create pools that sets may be freed back to one by one.
+	bool freeable = false;
+
+private:
+	/// Take a pool from the free list, or create one larger than the last.
+	/// 'created' is set if the pool is new, and so entirely empty.
+	VkDescriptorPool NextPool(bool &created);
+
+	/// Pool currently allocated from, null until the first Allocate().
+	VkDescriptorPool current = VK_NULL_HANDLE;
+	/// True if 'current' was empty when we moved to it.
+	bool currentCreated = false;
+	/// Filled pools, reset and moved to 'freePools' by Reset(), or by Free().
+	std::vector<VkDescriptorPool> usedPools;
+	std::vector<VkDescriptorPool> freePools;
+	/// Sets in the next pool created.
+	uint32_t nextPoolSets = DESCRIPTOR_POOL_MIN_SETS;
+};
+
+#endif
@@ -0,0 +1,198 @@
+#include "imDescriptorCache.h"
+
+#include <iterator>
+
+imDescriptorCache descriptorCache;
+
+/// Integers each write adds to a key, in the order Get() appends them.
+static const size_t WRITE_FIELDS = 8;
+/// Positions of the buffer, view and sampler handles within those.
+static const size_t WRITE_HANDLES[] = { 2, 5, 6 };
+
+/// Bits of a handle, which is a pointer or a 64 bit integer by platform.
+template <typename T>
+static uint64_t HandleBits(T handle) {
+	uint64_t bits = 0;
+	memcpy(&bits, &handle, sizeof(handle));
+	return bits;
+}
+
+imDescriptorWrite imDescriptorWrite::Buffer(uint32_t binding, VkDescriptorType type,
+		VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+	imDescriptorWrite write;
+	write.binding = binding;
+	write.type = type;
+	write.buffer = buffer;
+	write.offset = offset;
+	write.range = range;
+	return write;
+}
+
+imDescriptorWrite imDescriptorWrite::Image(uint32_t binding, VkDescriptorType type,
+		VkImageView view, VkSampler sampler, VkImageLayout layout) {
+	imDescriptorWrite write;
+	write.binding = binding;
+	write.type = type;
+	write.view = view;
+	write.sampler = sampler;
+	write.layout = layout;
+	return write;
+}
+
+imDescriptorCache::imDescriptorCache() {
+	// Sets leave the cache one at a time.
+	allocator.freeable = true;
+}
+
+size_t imDescriptorCache::KeyHash::operator()(const Key &key) const {
+	// FNV-1a over each value.
+	uint64_t hash = 14695981039346656037ull;
+	for (uint64_t value : key) {
+		hash ^= value;
+		hash *= 1099511628211ull;
+	}
+
+	return static_cast<size_t>(hash);
+}
+
+VkDescriptorSet imDescriptorCache::Get(VkDescriptorSetLayout layout,
+		const std::vector<imDescriptorWrite> &writes) {
+	Key key;
+	key.reserve(1 + writes.size() * WRITE_FIELDS);
+	key.push_back(HandleBits(layout));
+	for (const imDescriptorWrite &write : writes) {
+		key.push_back(write.binding);
+		key.push_back(static_cast<uint64_t>(write.type));
+		key.push_back(HandleBits(write.buffer));
+		key.push_back(write.offset);
+		key.push_back(write.range);
+		key.push_back(HandleBits(write.view));
+		key.push_back(HandleBits(write.sampler));
+		key.push_back(static_cast<uint64_t>(write.layout));
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = lookup.find(key);
+	if (it != lookup.end()) {
+		// Most recently used moves to the front.
+		entries.splice(entries.begin(), entries, it->second);
+		it->second->frame = frameNumber;
+		hits++;
+		return it->second->set;
+	}
+
+	if (entries.size() >= DESCRIPTOR_CACHE_CAPACITY) {
+		Evict(std::prev(entries.end()));
+	}
+
+	Entry entry;
+	entry.key = key;
+	entry.set = allocator.Allocate(layout, &entry.pool);
+	entry.frame = frameNumber;
+
+	std::vector<VkDescriptorBufferInfo> bufferInfos(writes.size());
+	std::vector<VkDescriptorImageInfo> imageInfos(writes.size());
+	std::vector<VkWriteDescriptorSet> descriptorWrites(writes.size());
+	for (size_t i = 0; i < writes.size(); i++) {
+		const imDescriptorWrite &write = writes[i];
+		VkWriteDescriptorSet &descriptorWrite = descriptorWrites[i];
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = entry.set;
+		descriptorWrite.dstBinding = write.binding;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType = write.type;
+		descriptorWrite.descriptorCount = 1;
+
+		if (write.buffer != VK_NULL_HANDLE) {
+			bufferInfos[i].buffer = write.buffer;
+			bufferInfos[i].offset = write.offset;
+			bufferInfos[i].range = write.range;
+			descriptorWrite.pBufferInfo = &bufferInfos[i];
+		} else {
+			imageInfos[i].imageView = write.view;
+			imageInfos[i].sampler = write.sampler;
+			imageInfos[i].imageLayout = write.layout;
+			descriptorWrite.pImageInfo = &imageInfos[i];
+		}
+	}
+
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()),
+		descriptorWrites.data(), 0, nullptr);
+
+	misses++;
+	entries.push_front(entry);
+	lookup[key] = entries.begin();
+	return entry.set;
+}
+
+void imDescriptorCache::Forget(VkBuffer buffer) {
+	Forget(HandleBits(buffer));
+}
+
+void imDescriptorCache::Forget(VkImageView view) {
+	Forget(HandleBits(view));
+}
+
+void imDescriptorCache::Forget(VkSampler sampler) {
+	Forget(HandleBits(sampler));
+}
+
+void imDescriptorCache::Forget(uint64_t handle) {
+	if (handle == 0) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto it = entries.begin(); it != entries.end(); ) {
+		auto next = std::next(it);
+
+		// Only compare handles, an offset or range may hold the same value.
+		bool refers = false;
+		for (size_t i = 1; i < it->key.size() && !refers; i += WRITE_FIELDS) {
+			for (size_t field : WRITE_HANDLES) {
+				refers = refers || it->key[i + field] == handle;
+			}
+		}
+
+		if (refers) {
+			Evict(it);
+		}
+
+		it = next;
+	}
+}
+
+void imDescriptorCache::Evict(std::list<Entry>::iterator entry) {
+	lookup.erase(entry->key);
+	retired.push_back(*entry);
+	entries.erase(entry);
+	evictions++;
+}
+
+void imDescriptorCache::Update(uint64_t frameNumber) {
+	std::lock_guard<std::mutex> lock(mutex);
+	this->frameNumber = frameNumber;
+
+	for (auto it = retired.begin(); it != retired.end(); ) {
+		if (frameNumber >= it->frame + MAX_FRAMES_IN_FLIGHT) {
+			allocator.Free(it->set, it->pool);
+			it = retired.erase(it);
+		} else {
+			it++;
+		}
+	}
+}
+
+void imDescriptorCache::PrintStats() {
+	std::cout << "Descriptor Cache: " << entries.size() << " sets, " << hits << " hits, "
+		<< misses << " misses, " << evictions << " evicted" << std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
+}
+
+void imDescriptorCache::Cleanup() {
+	// Destroying the pools frees every set in them.
+	allocator.Cleanup();
+	entries.clear();
+	lookup.clear();
+	retired.clear();
+}
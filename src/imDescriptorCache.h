@@ -0,0 +1,105 @@
+#ifndef IM_DESCRIPTOR_CACHE_H
+#define IM_DESCRIPTOR_CACHE_H
+
+#include "imVulkan.h"
+#include "imDescriptorAllocator.h"
+
+#include <unordered_map>
+#include <mutex>
+#include <list>
+
+/// Sets kept before the least recently used ones are evicted.
+const size_t DESCRIPTOR_CACHE_CAPACITY = 1024;
+
+/// What one binding of a set points at, a buffer range or an image and sampler.
+struct imDescriptorWrite {
+	uint32_t binding = 0;
+	VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize range = 0;
+
+	VkImageView view = VK_NULL_HANDLE;
+	VkSampler sampler = VK_NULL_HANDLE;
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	static imDescriptorWrite Buffer(uint32_t binding, VkDescriptorType type,
+		VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+	static imDescriptorWrite Image(uint32_t binding, VkDescriptorType type,
+		VkImageView view, VkSampler sampler,
+		VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+};
+
+/// Hands out descriptor sets keyed by their layout and everything written to
+/// them, so materials binding the same buffers, images and samplers share one
+/// set rather than each allocating and writing their own. Sets stay valid
+/// until one of the resources they point at is forgotten, or they fall out of
+/// the cache, and are only freed once no frame in flight can be using them.
+class imDescriptorCache {
+public:
+	imDescriptorCache();
+
+	/// Set of 'layout' holding 'writes', allocated and written on a miss.
+	/// Call while recording the frame passed to the last Update().
+	VkDescriptorSet Get(VkDescriptorSetLayout layout,
+		const std::vector<imDescriptorWrite> &writes);
+
+	/// Evict every set pointing at the resource, call before destroying it.
+	void Forget(VkBuffer buffer);
+	void Forget(VkImageView view);
+	void Forget(VkSampler sampler);
+
+	/// Free sets evicted MAX_FRAMES_IN_FLIGHT frames ago, once per frame.
+	void Update(uint64_t frameNumber);
+
+	/// Print hits, misses and evictions.
+	void PrintStats();
+	/// Free every set and destroy the pools, the device must be idle.
+	void Cleanup();
+
+	/// Requests served by an existing set.
+	uint32_t hits = 0;
+	/// Requests that allocated and wrote a new set.
+	uint32_t misses = 0;
+	/// Sets evicted, to make room or because a resource was forgotten.
+	uint32_t evictions = 0;
+
+private:
+	/// The layout, then binding, type and handles of each write, as integers.
+	typedef std::vector<uint64_t> Key;
+
+	struct KeyHash {
+		size_t operator()(const Key &key) const;
+	};
+
+	struct Entry {
+		Key key;
+		VkDescriptorSet set;
+		VkDescriptorPool pool;
+		/// Last frame recorded with this set.
+		uint64_t frame;
+	};
+
+	/// Remove every entry referring to the handle.
+	void Forget(uint64_t handle);
+	/// Move the entry out of the cache, to be freed once its frame is done.
+	void Evict(std::list<Entry>::iterator entry);
+
+	/// Guards everything below, resources may be destroyed on any thread.
+	std::mutex mutex;
+	imDescriptorAllocator allocator;
+
+	/// Most recently used first.
+	std::list<Entry> entries;
+	std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> lookup;
+	/// Evicted entries still waiting on their frame.
+	std::vector<Entry> retired;
+	/// Frame last passed to Update().
+	uint64_t frameNumber = 0;
+};
+
+/// Global descriptor set cache.
+extern imDescriptorCache descriptorCache;
+
+#endif
@@ -0,0 +1,206 @@
+#include "imFrustum.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+	#define IM_FRUSTUM_X86
+	#include <immintrin.h>
+#endif
+
+/// Arrays are padded to a multiple of the widest kernel.
+static const uint32_t SPHERE_PADDING = 8;
+/// Radius of padding spheres, no plane distance can be below its negation.
+static const float PADDING_RADIUS = -std::numeric_limits<float>::max();
+
+imFrustum imFrustum::FromMatrix(const glm::mat4 &m) {
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	imFrustum frustum;
+	frustum.planes[0] = row3 + row0; // left
+	frustum.planes[1] = row3 - row0; // right
+	frustum.planes[2] = row3 + row1; // bottom
+	frustum.planes[3] = row3 - row1; // top
+	frustum.planes[4] = row2;        // near
+	frustum.planes[5] = row3 - row2; // far
+
+	for (int i = 0; i < 6; i++) {
+		frustum.planes[i] = frustum.planes[i] / glm::length(glm::vec3(frustum.planes[i]));
+	}
+
+	return frustum;
+}
+
+uint32_t imSphereSet::Add(const glm::vec3 &center, float r) {
+	if (count == x.size()) {
+		size_t size = x.size() + SPHERE_PADDING;
+		x.resize(size, 0.0f);
+		y.resize(size, 0.0f);
+		z.resize(size, 0.0f);
+		radius.resize(size, PADDING_RADIUS);
+	}
+
+	Set(count, center, r);
+	return count++;
+}
+
+void imSphereSet::Set(uint32_t index, const glm::vec3 &center, float r) {
+	x[index] = center.x;
+	y[index] = center.y;
+	z[index] = center.z;
+	radius[index] = r;
+}
+
+void imSphereSet::Clear() {
+	x.clear();
+	y.clear();
+	z.clear();
+	radius.clear();
+	count = 0;
+}
+
+void imSphereSet::Cull(const imFrustum &frustum, std::vector<uint32_t> &visible,
+		imCullPath path) const {
+	// Never run a kernel this CPU can't execute.
+	if (path == IM_CULL_BEST || path > BestPath()) {
+		path = BestPath();
+	}
+
+	// Kernels write without bounds checks, the list can only shrink.
+	visible.resize(x.size());
+
+	uint32_t visibleCount;
+	switch (path) {
+	case IM_CULL_AVX: visibleCount = CullAVX(frustum, visible.data()); break;
+	case IM_CULL_SSE: visibleCount = CullSSE(frustum, visible.data()); break;
+	default: visibleCount = CullScalar(frustum, visible.data()); break;
+	}
+
+	visible.resize(visibleCount);
+}
+
+imCullPath imSphereSet::BestPath() {
+#ifdef IM_FRUSTUM_X86
+	static const imCullPath best = __builtin_cpu_supports("avx") ? 
+		IM_CULL_AVX : IM_CULL_SSE;
+	return best;
+#else
+	return IM_CULL_SCALAR;
+#endif
+}
+
+const char * imSphereSet::PathName(imCullPath path) {
+	switch (path) {
+	case IM_CULL_SCALAR: return "Scalar";
+	case IM_CULL_SSE: return "SSE";
+	case IM_CULL_AVX: return "AVX";
+	default: return PathName(BestPath());
+	}
+}
+
+uint32_t imSphereSet::CullScalar(const imFrustum &frustum, uint32_t * visible) const {
+	uint32_t visibleCount = 0;
+
+	for (uint32_t i = 0; i < count; i++) {
+		bool inside = true;
+
+		for (int p = 0; p < 6 && inside; p++) {
+			const glm::vec4 &plane = frustum.planes[p];
+			float dist = plane.x * x[i] + plane.y * y[i] + plane.z * z[i] + plane.w;
+			inside = dist >= -radius[i];
+		}
+
+		if (inside) {
+			visible[visibleCount++] = i;
+		}
+	}
+
+	return visibleCount;
+}
+
+#ifdef IM_FRUSTUM_X86
+
+uint32_t imSphereSet::CullSSE(const imFrustum &frustum, uint32_t * visible) const {
+	__m128 planes[6][4];
+	for (int p = 0; p < 6; p++) {
+		for (int c = 0; c < 4; c++) {
+			planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+		}
+	}
+
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	uint32_t visibleCount = 0;
+
+	// Padding spheres always fail, so whole registers can be tested.
+	for (uint32_t i = 0; i < count; i += 4) {
+		__m128 cx = _mm_loadu_ps(&x[i]);
+		__m128 cy = _mm_loadu_ps(&y[i]);
+		__m128 cz = _mm_loadu_ps(&z[i]);
+		__m128 negRadius = _mm_xor_ps(_mm_loadu_ps(&radius[i]), signBit);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(planes[p][0], cx), _mm_mul_ps(planes[p][1], cy)),
+				_mm_mul_ps(planes[p][2], cz)), planes[p][3]);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, negRadius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		while (mask) {
+			visible[visibleCount++] = i + __builtin_ctz(mask);
+			mask &= mask - 1;
+		}
+	}
+
+	return visibleCount;
+}
+
+__attribute__((target("avx")))
+uint32_t imSphereSet::CullAVX(const imFrustum &frustum, uint32_t * visible) const {
+	__m256 planes[6][4];
+	for (int p = 0; p < 6; p++) {
+		for (int c = 0; c < 4; c++) {
+			planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+		}
+	}
+
+	const __m256 signBit = _mm256_set1_ps(-0.0f);
+	uint32_t visibleCount = 0;
+
+	for (uint32_t i = 0; i < count; i += 8) {
+		__m256 cx = _mm256_loadu_ps(&x[i]);
+		__m256 cy = _mm256_loadu_ps(&y[i]);
+		__m256 cz = _mm256_loadu_ps(&z[i]);
+		__m256 negRadius = _mm256_xor_ps(_mm256_loadu_ps(&radius[i]), signBit);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+				_mm256_mul_ps(planes[p][0], cx), _mm256_mul_ps(planes[p][1], cy)),
+				_mm256_mul_ps(planes[p][2], cz)), planes[p][3]);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, negRadius, _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		while (mask) {
+			visible[visibleCount++] = i + __builtin_ctz(mask);
+			mask &= mask - 1;
+		}
+	}
+
+	return visibleCount;
+}
+
+#else
+
+// Without x86 intrinsics every path is the reference path.
+uint32_t imSphereSet::CullSSE(const imFrustum &frustum, uint32_t * visible) const {
+	return CullScalar(frustum, visible);
+}
+
+uint32_t imSphereSet::CullAVX(const imFrustum &frustum, uint32_t * visible) const {
+	return CullScalar(frustum, visible);
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef IM_FRUSTUM_H
+#define IM_FRUSTUM_H
+
+#include "PREFIX.h"
+
+/// Kernel used to test bounding volumes against a frustum.
+enum imCullPath {
+	/// Reference implementation, one sphere at a time.
+	IM_CULL_SCALAR,
+	/// Four spheres per iteration.
+	IM_CULL_SSE,
+	/// Eight spheres per iteration.
+	IM_CULL_AVX,
+	/// Widest kernel the running CPU supports.
+	IM_CULL_BEST
+};
+
+/// Six inward facing, normalized planes, xyz is the normal and w the distance.
+struct imFrustum {
+	glm::vec4 planes[6];
+
+	/// Extract the planes from a clip space transform, with Vulkan's 0 to 1 depth range.
+	static imFrustum FromMatrix(const glm::mat4 &m);
+};
+
+/// Bounding spheres stored as a structure of arrays, so a SIMD kernel can test
+/// a register's worth of spheres against each plane at once. The arrays are
+/// padded with spheres that can never be visible, so kernels need no tail loop.
+class imSphereSet {
+public:
+	/// Append a sphere, returns the index it is reported by.
+	uint32_t Add(const glm::vec3 &center, float radius);
+	/// Move an existing sphere.
+	void Set(uint32_t index, const glm::vec3 &center, float radius);
+	void Clear();
+
+	uint32_t Size() const { return count; }
+
+	/// Replace 'visible' with the indices of every sphere touching the frustum,
+	/// in ascending order. Every path returns the same list.
+	void Cull(const imFrustum &frustum, std::vector<uint32_t> &visible,
+		imCullPath path = IM_CULL_BEST) const;
+
+	/// Widest kernel the running CPU supports.
+	static imCullPath BestPath();
+	static const char * PathName(imCullPath path);
+
+private:
+	uint32_t CullScalar(const imFrustum &frustum, uint32_t * visible) const;
+	uint32_t CullSSE(const imFrustum &frustum, uint32_t * visible) const;
+	uint32_t CullAVX(const imFrustum &frustum, uint32_t * visible) const;
+
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	std::vector<float> radius;
+	uint32_t count = 0;
+};
+
+#endif
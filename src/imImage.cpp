@@ -1,66 +1,175 @@
 #include "imImage.h"
 #include "imBuffer.h"
+#include "imStagingRing.h"
+#include "imCommandContext.h"
+#include "imDescriptorCache.h"
+#include "imSamplerCache.h"
+#include "imMipChain.h"
+#include "imTextureFile.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
-void imImage::Create(std::string filename) {
+void imImage::Create(std::string filename, bool srgb) {
+	Create(Decode(filename, srgb));
+}
+
+imImageData imImage::Decode(const std::string &filename, bool srgb, bool fullChain) {
+	imImageData data;
+
+	if (imTextureFile::IsContainer(filename)) {
+		imTextureFile file;
+		file.Load(filename, srgb);
+
+		// There is no decoder to fall back on, a device without BC support throws.
+		data.format = FindSupportedFormat({ file.format }, VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | 
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+		data.width = file.width;
+		data.height = file.height;
+		data.mipLevels = static_cast<uint32_t>(file.levels.size());
+
+		// Levels go to the GPU untouched, every one of them comes from the file.
+		for (const imTextureFile::Level &level : file.levels) {
+			const uint8_t * start = file.data.data() + level.offset;
+			data.levels.emplace_back(start, start + level.size);
+		}
+
+		// Only RGBA8 files leave their mips to us, built the same way as for
+		// any other image.
+		if (file.generateMips) {
+			data.mipLevels = imMipChain::LevelsFor(data.width, data.height);
+			if (fullChain || !SupportsLinearBlit(data.format)) {
+				imMipChain chain;
+				chain.Generate(data.levels[0].data(), data.width, data.height,
+					data.mipLevels, data.format == VK_FORMAT_R8G8B8A8_SRGB);
+				data.levels = chain.Release();
+			}
+		}
+
+		return data;
+	}
+
 	int iwidth, iheight, channels;
 	stbi_uc * pixels = stbi_load(filename.c_str(), &iwidth, &iheight, 
 		&channels, STBI_rgb_alpha);
-	VkDeviceSize imageSize = iwidth * iheight * 4;
-
-	width = static_cast<uint32_t>(iwidth);
-	height = static_cast<uint32_t>(iheight);
 
 	if (!pixels) {
 		throw std::runtime_error("Failed to load texture image!");
 	}
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-		stagingBuffer, stagingBufferMemory);
+	// sRGB formats are filtered in linear space, by samplers and blits alike.
+	data.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	data.width = static_cast<uint32_t>(iwidth);
+	data.height = static_cast<uint32_t>(iheight);
+	data.mipLevels = imMipChain::LevelsFor(data.width, data.height);
 
-	void * data;
-	vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(device, stagingBufferMemory);
+	if (!fullChain && SupportsLinearBlit(data.format)) {
+		// Only level 0 is uploaded, the GPU blits the rest.
+		data.levels.emplace_back(pixels, pixels + static_cast<size_t>(iwidth) * iheight * 4);
+	} else {
+		imMipChain chain;
+		chain.Generate(pixels, data.width, data.height, data.mipLevels, srgb);
+		data.levels = chain.Release();
+	}
 
 	stbi_image_free(pixels);
+	return data;
+}
 
-	imageFormat = VK_FORMAT_R8G8B8A8_UNORM;
-	imImage::Allocate(width, height,
-		imageFormat, VK_IMAGE_TILING_OPTIMAL, 
-		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+void imImage::Create(const imImageData &data, uint32_t baseLevel) {
+	if (baseLevel >= data.levels.size()) {
+		throw std::runtime_error("Base level was not decoded!");
+	}
+
+	imageFormat = data.format;
+	width = std::max(data.width >> baseLevel, 1u);
+	height = std::max(data.height >> baseLevel, 1u);
+	mipLevels = data.mipLevels - baseLevel;
+
+	// Blitting the missing levels reads from the image as well, as does
+	// CreateMipTail() when the texture streamer drops fine levels.
+	imImage::Allocate(width, height, imageFormat, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+		VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		image, memory, mipLevels);
+
+	// The pixels are copied into the staging ring right away, the transfer
+	// itself happens whenever the ring is next flushed.
+	std::vector<imImageLevel> levels;
+	for (size_t level = baseLevel; level < data.levels.size(); level++) {
+		levels.push_back({ data.levels[level].data(), data.levels[level].size() });
+	}
 
-	imImage::TransitionImageLayout(image, imageFormat, VK_IMAGE_LAYOUT_UNDEFINED, 
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-	CopyBufferToImage(stagingBuffer);
-	imImage::TransitionImageLayout(image, imageFormat, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	stagingRing.UploadImage(image, imageFormat, width, height, mipLevels, levels);
 
-	view = imImage::CreateView(image, imageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+	view = imImage::CreateView(image, imageFormat, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
 	CreateSampler();
+}
+
+void imImage::CreateMipTail(const imImage &source, uint32_t skipLevels) {
+	if (skipLevels >= source.mipLevels) {
+		throw std::runtime_error("Can't skip every mip level!");
+	}
 
-	// Cleanup
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	imageFormat = source.imageFormat;
+	width = std::max(source.width >> skipLevels, 1u);
+	height = std::max(source.height >> skipLevels, 1u);
+	mipLevels = source.mipLevels - skipLevels;
+
+	imImage::Allocate(width, height, imageFormat, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+		VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		image, memory, mipLevels);
+
+	// The graphics queue owns every sampled image, so the copy runs there.
+	VkCommandBuffer commandBuffer = oneTimeCommands.Record();
+	TransitionImageLayout(commandBuffer, source.image, imageFormat,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		skipLevels, mipLevels);
+	TransitionImageLayout(commandBuffer, image, imageFormat,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+	// Each level is copied whole, which is valid for block compressed
+	// levels smaller than a block too.
+	std::vector<VkImageCopy> regions(mipLevels);
+	for (uint32_t level = 0; level < mipLevels; level++) {
+		VkImageCopy &region = regions[level];
+		region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.srcSubresource.mipLevel = skipLevels + level;
+		region.srcSubresource.layerCount = 1;
+		region.dstSubresource = region.srcSubresource;
+		region.dstSubresource.mipLevel = level;
+		region.extent.width = std::max(width >> level, 1u);
+		region.extent.height = std::max(height >> level, 1u);
+		region.extent.depth = 1;
+	}
+
+	vkCmdCopyImage(commandBuffer, source.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()), regions.data());
+
+	TransitionImageLayout(commandBuffer, source.image, imageFormat,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		skipLevels, mipLevels);
+	TransitionImageLayout(commandBuffer, image, imageFormat,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	view = imImage::CreateView(image, imageFormat, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+	CreateSampler();
 }
 
 void imImage::Cleanup() {
-	vkDestroySampler(device, sampler, nullptr);
+	descriptorCache.Forget(view);
+	samplerCache.Release(sampler);
 	vkDestroyImageView(device, view, nullptr);
 	vkDestroyImage(device, image, nullptr);
-	vkFreeMemory(device, memory, nullptr);
+	allocator.Free(memory);
 }
 
 void imImage::Allocate(uint32_t width, uint32_t height, VkFormat imageFormat,
 		VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
-		VkImage &image, VkDeviceMemory &memory) {
+		VkImage &image, imAllocation &memory, uint32_t mipLevels) {
 
 	VkImageCreateInfo imageInfo = { };
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -68,7 +177,7 @@ void imImage::Allocate(uint32_t width, uint32_t height, VkFormat imageFormat,
 	imageInfo.extent.width = width;
 	imageInfo.extent.height = height;
 	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = 1;
+	imageInfo.mipLevels = mipLevels;
 	imageInfo.arrayLayers = 1;
 
 	imageInfo.format = imageFormat;
@@ -86,24 +195,20 @@ void imImage::Allocate(uint32_t width, uint32_t height, VkFormat imageFormat,
 	VkMemoryRequirements memReqs;
 	vkGetImageMemoryRequirements(device, image, &memReqs);
 
-	VkMemoryAllocateInfo allocInfo = { };
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memReqs.size;
-	allocInfo.memoryTypeIndex = FindMemoryType(memReqs.memoryTypeBits, 
-		properties);
-
-	if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to allocate image memory!");
-	}
-
-	vkBindImageMemory(device, image, memory, 0);
+	memory = allocator.Allocate(memReqs, properties, tiling == VK_IMAGE_TILING_LINEAR);
+	vkBindImageMemory(device, image, memory.memory, memory.offset);
 }
 
 void imImage::TransitionImageLayout(VkImage image, VkFormat format, 
-		VkImageLayout oldLayout, VkImageLayout newLayout) {
-
-	VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
+		VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel,
+		uint32_t levelCount) {
+	TransitionImageLayout(oneTimeCommands.Record(), image, format, oldLayout, newLayout,
+		baseMipLevel, levelCount);
+}
 
+void imImage::TransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image,
+		VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout,
+		uint32_t baseMipLevel, uint32_t levelCount) {
 	VkImageMemoryBarrier barrier = { };
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	barrier.oldLayout = oldLayout;
@@ -113,8 +218,8 @@ void imImage::TransitionImageLayout(VkImage image, VkFormat format,
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 
 	barrier.image = image;
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseMipLevel = baseMipLevel;
+	barrier.subresourceRange.levelCount = levelCount;
 	barrier.subresourceRange.baseArrayLayer = 0;
 	barrier.subresourceRange.layerCount = 1;
 
@@ -147,6 +252,32 @@ void imImage::TransitionImageLayout(VkImage image, VkFormat format,
 		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 		dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 
+	} else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && 
+			newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+		// A finished mip level, about to be blitted into the next.
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+	} else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL && 
+			newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+	} else if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && 
+			newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+		// Copied from once earlier draws have finished sampling it.
+		barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		sourceStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
 	} else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
 			newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
 		barrier.srcAccessMask = 0;
@@ -165,36 +296,72 @@ void imImage::TransitionImageLayout(VkImage image, VkFormat format,
 		0, 0, nullptr, 0, nullptr, 
 		1, &barrier
 	);
-
-	EndSingleTimeCommands(commandBuffer);
 }
 
-void imImage::CopyBufferToImage(VkBuffer buffer) {
-	VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
-
-	VkBufferImageCopy region = { };
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
+bool imImage::SupportsLinearBlit(VkFormat format) {
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
 
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
+	VkFormatFeatureFlags features = VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+		VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (props.optimalTilingFeatures & features) == features;
+}
 
-	region.imageOffset = { 0, 0, 0 };
-	region.imageExtent = {
-		width, height, 1
-	};
+void imImage::GenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image,
+		VkFormat format, uint32_t width, uint32_t height, uint32_t firstLevel,
+		uint32_t mipLevels) {
+	int32_t srcWidth = static_cast<int32_t>(std::max(width >> (firstLevel - 1), 1u));
+	int32_t srcHeight = static_cast<int32_t>(std::max(height >> (firstLevel - 1), 1u));
+
+	for (uint32_t level = firstLevel; level < mipLevels; level++) {
+		int32_t dstWidth = std::max(srcWidth / 2, 1);
+		int32_t dstHeight = std::max(srcHeight / 2, 1);
+
+		// Each level is read once, for the next, then is ready for sampling.
+		TransitionImageLayout(commandBuffer, image, format,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			level - 1, 1);
+
+		VkImageBlit blit = { };
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = 1;
+		blit.srcOffsets[0] = { 0, 0, 0 };
+		blit.srcOffsets[1] = { srcWidth, srcHeight, 1 };
+
+		blit.dstSubresource = blit.srcSubresource;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstOffsets[0] = { 0, 0, 0 };
+		blit.dstOffsets[1] = { dstWidth, dstHeight, 1 };
+
+		vkCmdBlitImage(commandBuffer, 
+			image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit, VK_FILTER_LINEAR);
+
+		TransitionImageLayout(commandBuffer, image, format,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			level - 1, 1);
+
+		srcWidth = dstWidth;
+		srcHeight = dstHeight;
+	}
 
-	vkCmdCopyBufferToImage(commandBuffer, buffer, image, 
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	// Levels never blitted from, those uploaded above the first source, and the last.
+	if (firstLevel > 1) {
+		TransitionImageLayout(commandBuffer, image, format,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			0, firstLevel - 1);
+	}
 
-	EndSingleTimeCommands(commandBuffer);
+	TransitionImageLayout(commandBuffer, image, format,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		mipLevels - 1, 1);
 }
 
 VkImageView imImage::CreateView(VkImage image, VkFormat format, 
-		VkImageAspectFlags aspectFlags) {
+		VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
 
 	VkImageViewCreateInfo viewInfo = { };
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -203,7 +370,7 @@ VkImageView imImage::CreateView(VkImage image, VkFormat format,
 	viewInfo.format = format;
 	viewInfo.subresourceRange.aspectMask = aspectFlags;
 	viewInfo.subresourceRange.baseMipLevel = 0;
-	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.levelCount = mipLevels;
 	viewInfo.subresourceRange.baseArrayLayer = 0;
 	viewInfo.subresourceRange.layerCount = 1;
 
@@ -237,9 +404,9 @@ void imImage::CreateSampler() {
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = 0.0f;
+	// Unclamped, so every texture shares this sampler whatever its level count.
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
-	if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create texture sampler!");
-	}
+	// Every texture with these settings shares the one sampler.
+	sampler = samplerCache.Get(samplerInfo);
 }
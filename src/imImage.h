@@ -2,21 +2,69 @@
 #define IM_IMAGE_H
 
 #include "imVulkan.h"
+#include "imAllocator.h"
 #include <string>
 
+/// Texels of an image decoded on the CPU, everything imImage::Create needs
+/// besides the device.
+struct imImageData {
+	VkFormat format;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	/// Levels of the finished image, those past 'levels' are blitted.
+	uint32_t mipLevels = 1;
+	/// Tightly packed texels of each level to upload, largest first.
+	std::vector<std::vector<uint8_t>> levels;
+};
+
 class imImage {
 public:
-	void Create(std::string filename);
+	/// Load an image file with a full mip chain. Color images are 'srgb',
+	/// data such as normal maps should pass false. KTX2 and DDS files, such
+	/// as those written by tools/texcook, are uploaded as stored along with
+	/// their own mips.
+	void Create(std::string filename, bool srgb = true);
+	/// Create the image and queue the upload of 'data' on the staging ring.
+	/// A 'baseLevel' above 0 leaves out that many of the finest levels, the
+	/// image then starts at the size of that level.
+	void Create(const imImageData &data, uint32_t baseLevel = 0);
+	/// Create an image holding the levels of 'source' from 'skipLevels' on,
+	/// copied on the graphics queue through the one time command context.
+	/// 'source' must be in SHADER_READ_ONLY_OPTIMAL and is left there.
+	void CreateMipTail(const imImage &source, uint32_t skipLevels);
+	/// Read and decode an image file as Create() would, without touching
+	/// the device, so it may run on any thread. With 'fullChain' every level
+	/// is built on the CPU, even those the GPU could blit.
+	static imImageData Decode(const std::string &filename, bool srgb = true,
+		bool fullChain = false);
 
 	static void Allocate(uint32_t width, uint32_t height, VkFormat imageFormat,
 		VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
-		VkImage &image, VkDeviceMemory &memory);
+		VkImage &image, imAllocation &memory, uint32_t mipLevels = 1);
 	static VkImageView CreateView(VkImage image, VkFormat format, 
-		VkImageAspectFlags aspectFlags);
+		VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1);
+	/// Record the layout transition into the one time command context,
+	/// it takes effect on the context's next flush.
 	static void TransitionImageLayout(VkImage image, VkFormat format, 
-		VkImageLayout oldLayout, VkImageLayout newLayout);
+		VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel = 0,
+		uint32_t levelCount = VK_REMAINING_MIP_LEVELS);
+	/// Record the layout transition of the given mip levels, every level
+	/// by default, into an existing command buffer.
+	static void TransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image,
+		VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout,
+		uint32_t baseMipLevel = 0, uint32_t levelCount = VK_REMAINING_MIP_LEVELS);
+
+	/// True if the GPU can build mip chains of 'format' with linear blits.
+	static bool SupportsLinearBlit(VkFormat format);
+	/// Record blits filling levels 'firstLevel' onward of a 'mipLevels' level
+	/// image, each from the level above. Every level must be in
+	/// TRANSFER_DST_OPTIMAL, and is left in SHADER_READ_ONLY_OPTIMAL. Needs
+	/// a graphics queue.
+	static void GenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image,
+		VkFormat format, uint32_t width, uint32_t height, uint32_t firstLevel,
+		uint32_t mipLevels);
 
-	void CopyBufferToImage(VkBuffer buffer);
+	/// Take a reference to a shared sampler from the sampler cache.
 	void CreateSampler();
 	
 	void Cleanup();
@@ -24,10 +72,11 @@ public:
 	VkImage image;
 	VkImageView view;
 	VkSampler sampler;
-	VkDeviceMemory memory;
+	imAllocation memory;
 	VkFormat imageFormat;
 	uint32_t width;
 	uint32_t height;
+	uint32_t mipLevels = 1;
 };
 
 #endif
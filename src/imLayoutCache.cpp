@@ -0,0 +1,202 @@
+#include "imLayoutCache.h"
+
+#include <algorithm>
+
+imLayoutCache layoutCache;
+
+VkPipelineLayout imLayoutCache::Get(const std::vector<const imShaderReflection *> &stages) {
+	// Bindings by set, then binding number.
+	std::map<uint32_t, std::map<uint32_t, VkDescriptorSetLayoutBinding>> sets;
+	VkPushConstantRange pushRange = { };
+
+	for (const imShaderReflection * stage : stages) {
+		for (const imReflectedBinding &reflected : stage->bindings) {
+			VkDescriptorType type = reflected.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+				? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : reflected.type;
+
+			auto &bindings = sets[reflected.set];
+			auto it = bindings.find(reflected.binding);
+			if (it == bindings.end()) {
+				VkDescriptorSetLayoutBinding binding = { };
+				binding.binding = reflected.binding;
+				binding.descriptorType = type;
+				binding.descriptorCount = reflected.count;
+				binding.stageFlags = stage->stage;
+				if (reflected.count == 0) {
+					// A bindless table, every pipeline binds the same one,
+					// so its layout must not depend on the stages using it.
+					binding.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+				}
+				bindings[reflected.binding] = binding;
+			} else if (it->second.descriptorType != type ||
+					it->second.descriptorCount != reflected.count) {
+				throw std::runtime_error("Shader stages disagree on a descriptor binding!");
+			} else {
+				it->second.stageFlags |= stage->stage;
+			}
+		}
+
+		// Our shaders share one push constant block between stages.
+		if (stage->pushConstantSize > 0) {
+			pushRange.size = std::max(pushRange.size, stage->pushConstantSize);
+			pushRange.stageFlags |= stage->stage;
+		}
+	}
+
+	// Set numbers index the layout array, unused numbers get an empty set.
+	std::vector<VkDescriptorSetLayout> layouts;
+	uint32_t setCount = sets.empty() ? 0 : sets.rbegin()->first + 1;
+	for (uint32_t set = 0; set < setCount; set++) {
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		for (auto &entry : sets[set]) {
+			bindings.push_back(entry.second);
+		}
+		layouts.push_back(GetSetLayout(bindings));
+	}
+
+	std::vector<VkPushConstantRange> pushConstants;
+	if (pushRange.size > 0) {
+		pushConstants.push_back(pushRange);
+	}
+
+	return GetPipelineLayout(layouts, pushConstants);
+}
+
+VkDescriptorSetLayout imLayoutCache::GetSetLayout(
+		const std::vector<VkDescriptorSetLayoutBinding> &bindings) {
+	SetKey key;
+	for (const auto &binding : bindings) {
+		key.push_back({ { binding.binding, static_cast<uint32_t>(binding.descriptorType),
+			binding.descriptorCount, binding.stageFlags } });
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = setLayouts.find(key);
+	if (it != setLayouts.end()) {
+		hits++;
+		return it->second;
+	}
+
+	std::vector<VkDescriptorSetLayoutBinding> created = bindings;
+	std::vector<VkDescriptorBindingFlagsEXT> bindingFlags(bindings.size(), 0);
+	bool updateAfterBind = false;
+	for (size_t i = 0; i < created.size(); i++) {
+		if (created[i].descriptorCount > 0) {
+			continue;
+		}
+
+		if (!descriptorIndexingSupported) {
+			throw std::runtime_error("Runtime descriptor arrays need descriptor indexing!");
+		}
+
+		// Textures come and go while frames using the table are in flight.
+		created[i].descriptorCount = RUNTIME_ARRAY_SIZE;
+		bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+		updateAfterBind = true;
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo = { };
+	flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	flagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	flagsInfo.pBindingFlags = bindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = { };
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(created.size());
+	layoutInfo.pBindings = created.data();
+	if (updateAfterBind) {
+		// Such sets can only come from update after bind pools.
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+		layoutInfo.pNext = &flagsInfo;
+	}
+
+	VkDescriptorSetLayout layout;
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout)
+			!= VK_SUCCESS) {
+		throw std::runtime_error("Failed to create descriptor set layout!");
+	}
+
+	misses++;
+	setLayouts[key] = layout;
+	setBindings[layout] = created;
+	return layout;
+}
+
+VkPipelineLayout imLayoutCache::GetPipelineLayout(
+		const std::vector<VkDescriptorSetLayout> &layouts,
+		const std::vector<VkPushConstantRange> &pushConstants) {
+	PipelineKey key;
+	key.first = layouts;
+	for (const auto &range : pushConstants) {
+		key.second.push_back({ { range.offset, range.size, range.stageFlags } });
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = pipelineLayouts.find(key);
+	if (it != pipelineLayouts.end()) {
+		hits++;
+		return it->second;
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = { };
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
+	pipelineLayoutInfo.pSetLayouts = layouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstants.size());
+	pipelineLayoutInfo.pPushConstantRanges = pushConstants.data();
+
+	VkPipelineLayout layout;
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layout)
+			!= VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline layout!");
+	}
+
+	misses++;
+	pipelineLayouts[key] = layout;
+	pipelineSets[layout] = layouts;
+	return layout;
+}
+
+const std::vector<VkDescriptorSetLayout> & imLayoutCache::SetLayouts(VkPipelineLayout layout) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = pipelineSets.find(layout);
+	if (it == pipelineSets.end()) {
+		throw std::runtime_error("Pipeline layout was not created by the layout cache!");
+	}
+
+	return it->second;
+}
+
+const std::vector<VkDescriptorSetLayoutBinding> & imLayoutCache::Bindings(
+		VkDescriptorSetLayout layout) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = setBindings.find(layout);
+	if (it == setBindings.end()) {
+		throw std::runtime_error("Descriptor set layout was not created by the layout cache!");
+	}
+
+	return it->second;
+}
+
+void imLayoutCache::PrintStats() {
+	std::cout << "Layouts: " << setLayouts.size() << " set, " << pipelineLayouts.size()
+		<< " pipeline, " << hits << " shared, " << misses << " created" << std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
+}
+
+void imLayoutCache::Cleanup() {
+	for (auto &entry : pipelineLayouts) {
+		vkDestroyPipelineLayout(device, entry.second, nullptr);
+	}
+
+	for (auto &entry : setLayouts) {
+		vkDestroyDescriptorSetLayout(device, entry.second, nullptr);
+	}
+
+	pipelineLayouts.clear();
+	pipelineSets.clear();
+	setLayouts.clear();
+	setBindings.clear();
+}
@@ -0,0 +1,68 @@
+#ifndef IM_LAYOUT_CACHE_H
+#define IM_LAYOUT_CACHE_H
+
+#include "imVulkan.h"
+#include "imShaderReflection.h"
+
+#include <mutex>
+#include <map>
+
+/// Descriptors reserved for a runtime array binding, e.g. a shader's
+/// 'sampler2D textures[]'. Such bindings are bindless tables, see
+/// imBindlessTextures, and need descriptor indexing.
+const uint32_t RUNTIME_ARRAY_SIZE = 4096;
+
+/// Creates descriptor set layouts and pipeline layouts from reflected shaders.
+/// Layouts are keyed by their contents, so every pipeline whose shaders
+/// declare the same interface shares one set of Vulkan objects.
+class imLayoutCache {
+public:
+	/// Pipeline layout for a pipeline made of the given stages. Bindings
+	/// used by several stages are merged, and uniform buffers are always
+	/// dynamic since every uniform block lives in the uniform ring.
+	VkPipelineLayout Get(const std::vector<const imShaderReflection *> &stages);
+
+	/// Set layout holding exactly 'bindings', created on first use. Bindings
+	/// with a count of 0 are runtime arrays, created with RUNTIME_ARRAY_SIZE
+	/// descriptors that may be left unwritten and updated after binding.
+	VkDescriptorSetLayout GetSetLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+	/// Pipeline layout over the given sets and push constants, created on first use.
+	VkPipelineLayout GetPipelineLayout(const std::vector<VkDescriptorSetLayout> &setLayouts,
+		const std::vector<VkPushConstantRange> &pushConstants);
+
+	/// Set layouts 'layout' was created with, indexed by set number.
+	const std::vector<VkDescriptorSetLayout> & SetLayouts(VkPipelineLayout layout);
+	/// Bindings 'layout' was created with, runtime arrays at their full size.
+	const std::vector<VkDescriptorSetLayoutBinding> & Bindings(VkDescriptorSetLayout layout);
+
+	/// Print how many layouts exist and how often they were shared.
+	void PrintStats();
+	/// Destroy every layout, after every pipeline using them is destroyed.
+	void Cleanup();
+
+	/// Requests served by an existing layout.
+	uint32_t hits = 0;
+	/// Requests that created a new layout.
+	uint32_t misses = 0;
+
+private:
+	/// Binding, type, count and stages of each binding.
+	typedef std::vector<std::array<uint32_t, 4>> SetKey;
+	/// Set layouts, then offset, size and stages of each push constant range.
+	typedef std::pair<std::vector<VkDescriptorSetLayout>,
+		std::vector<std::array<uint32_t, 3>>> PipelineKey;
+
+	/// Guards everything below, pipelines are described from several threads.
+	std::mutex mutex;
+
+	std::map<SetKey, VkDescriptorSetLayout> setLayouts;
+	std::map<VkDescriptorSetLayout, std::vector<VkDescriptorSetLayoutBinding>> setBindings;
+
+	std::map<PipelineKey, VkPipelineLayout> pipelineLayouts;
+	std::map<VkPipelineLayout, std::vector<VkDescriptorSetLayout>> pipelineSets;
+};
+
+/// Global layout cache, shared by graphics and compute pipelines.
+extern imLayoutCache layoutCache;
+
+#endif
@@ -1,5 +1,8 @@
 #include "imMesh.h"
 #include "imBuffer.h"
+#include "imStagingRing.h"
+
+#include <algorithm>
 
 void imMesh::Create() {
 	CreateVertexBuffer();
@@ -7,60 +10,40 @@ void imMesh::Create() {
 }
 
 void imMesh::CreateVertexBuffer() {
-	// Use this buffer as a staging buffer, it's cache coherent 
-	// so we'll have memory available as soon as we unmap it.
+	// The actual buffer holding our data, on the GPU and not accessible from
+	// the CPU. Its contents arrive through the staging ring.
 	VkDeviceSize bufferSize = sizeof(VERTICES[0]) * VERTICES.size();
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer, stagingBufferMemory);
-
-	void * data;
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, VERTICES.data(), (size_t)bufferSize);
-	vkUnmapMemory(device, stagingBufferMemory);
-
-	// This will be the actual buffer holding our data, copied from
-	// our staging buffer to a location on the GPU not accessible from the CPU.
 	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | 
 		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		vertexBuffer, vertexBufferMemory);
-	CopyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-
-	// Clean up the staging buffer, we don't need it anymore.
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	stagingRing.UploadBuffer(vertexBuffer, VERTICES.data(), bufferSize);
+
+	// Center the sphere on the vertices' bounding box.
+	glm::vec3 lo = VERTICES[0].pos;
+	glm::vec3 hi = VERTICES[0].pos;
+	for (const auto &vertex : VERTICES) {
+		lo = glm::min(lo, vertex.pos);
+		hi = glm::max(hi, vertex.pos);
+	}
+
+	glm::vec3 center = (lo + hi) * 0.5f;
+	float radius = 0.0f;
+	for (const auto &vertex : VERTICES) {
+		radius = std::max(radius, glm::length(vertex.pos - center));
+	}
+	bounds = glm::vec4(center, radius);
 }
 
 void imMesh::CreateIndexBuffer() {
 	VkDeviceSize bufferSize = sizeof(INDICES[0]) * INDICES.size();
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	
-	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer, stagingBufferMemory);
-
-	void * data;
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, INDICES.data(), (size_t)bufferSize);
-	vkUnmapMemory(device, stagingBufferMemory);
-
 	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT |
 		VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		indexBuffer, indexBufferMemory);
-	CopyBuffer(stagingBuffer, indexBuffer, bufferSize);
-
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	stagingRing.UploadBuffer(indexBuffer, INDICES.data(), bufferSize);
+	indexCount = static_cast<uint32_t>(INDICES.size());
 }
 
 void imMesh::Cleanup() {
-	vkDestroyBuffer(device, indexBuffer, nullptr);
-	vkFreeMemory(device, indexBufferMemory, nullptr);
-
-	vkDestroyBuffer(device, vertexBuffer, nullptr);
-	vkFreeMemory(device, vertexBufferMemory, nullptr);
+	DestroyBuffer(indexBuffer, indexBufferMemory);
+	DestroyBuffer(vertexBuffer, vertexBufferMemory);
 }
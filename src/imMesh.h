@@ -3,20 +3,28 @@
 
 #include "imVulkan.h"
 #include "imVertex.hpp"
+#include "imAllocator.h"
 
 class imMesh {
 public:
+	/// Upload the vertex and index data. Instances are owned by imCullPass,
+	/// which binds its compacted instances next to 'vertexBuffer'.
 	void Create();
 	void CreateVertexBuffer();
 	void CreateIndexBuffer();
+
 	void Cleanup();
 
 	VkBuffer vertexBuffer;
 	VkBuffer indexBuffer;
 
+	/// Bounding sphere of the vertices, xyz is the center and w the radius.
+	glm::vec4 bounds;
+	uint32_t indexCount = 0;
+
 private:
-	VkDeviceMemory vertexBufferMemory;
-	VkDeviceMemory indexBufferMemory;
+	imAllocation vertexBufferMemory;
+	imAllocation indexBufferMemory;
 };
 
 #endif
@@ -0,0 +1,188 @@
+#include "imMipChain.h"
+
+#include <cmath>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+	#define IM_MIP_X86
+	#include <emmintrin.h>
+#endif
+
+/// Linear values are quantized to this many steps to encode them as sRGB
+/// through a table, fine enough that no byte is off by more than one.
+static const uint32_t ENCODE_STEPS = 4095;
+
+/// Conversions shared by every kernel, so they all round the same way.
+struct imMipTables {
+	/// Byte to linear [0, 1], decoding sRGB or not.
+	float srgbToLinear[256];
+	float unormToLinear[256];
+	/// Quantized linear value to sRGB byte.
+	uint8_t linearToSrgb[ENCODE_STEPS + 1];
+};
+
+static imMipTables BuildTables() {
+	imMipTables tables;
+
+	for (int i = 0; i < 256; i++) {
+		float c = i / 255.0f;
+		tables.srgbToLinear[i] = c <= 0.04045f ? c / 12.92f
+			: std::pow((c + 0.055f) / 1.055f, 2.4f);
+		tables.unormToLinear[i] = i * (1.0f / 255.0f);
+	}
+
+	for (uint32_t i = 0; i <= ENCODE_STEPS; i++) {
+		float l = static_cast<float>(i) / ENCODE_STEPS;
+		float c = l <= 0.0031308f ? l * 12.92f
+			: 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+		tables.linearToSrgb[i] = static_cast<uint8_t>(std::lrint(c * 255.0f));
+	}
+
+	return tables;
+}
+
+static const imMipTables & Tables() {
+	static const imMipTables tables = BuildTables();
+	return tables;
+}
+
+/// One output row of the reference kernel, 'row0' and 'row1' are the
+/// source rows it averages.
+static void DownsampleRowScalar(const uint8_t * row0, const uint8_t * row1,
+		uint32_t width, uint32_t dstWidth, uint8_t * dst, bool srgb) {
+	const imMipTables &tables = Tables();
+
+	for (uint32_t x = 0; x < dstWidth; x++) {
+		uint32_t x0 = std::min(2 * x, width - 1) * 4;
+		uint32_t x1 = std::min(2 * x + 1, width - 1) * 4;
+
+		for (uint32_t c = 0; c < 4; c++) {
+			// Alpha is coverage, never gamma encoded.
+			bool encoded = srgb && c < 3;
+			const float * lut = encoded ? tables.srgbToLinear : tables.unormToLinear;
+			float sum = ((lut[row0[x0 + c]] + lut[row0[x1 + c]]) +
+				(lut[row1[x0 + c]] + lut[row1[x1 + c]])) * 0.25f;
+
+			dst[x * 4 + c] = encoded
+				? tables.linearToSrgb[std::lrint(sum * ENCODE_STEPS)]
+				: static_cast<uint8_t>(std::lrint(sum * 255.0f));
+		}
+	}
+}
+
+#ifdef IM_MIP_X86
+
+/// Linear RGBA of one pixel.
+static inline __m128 LoadPixel(const uint8_t * p, bool srgb) {
+	const imMipTables &tables = Tables();
+
+	if (srgb) {
+		// No gather in SSE2, the table lookups stay scalar.
+		return _mm_setr_ps(tables.srgbToLinear[p[0]], tables.srgbToLinear[p[1]],
+			tables.srgbToLinear[p[2]], tables.unormToLinear[p[3]]);
+	}
+
+	int32_t bits;
+	memcpy(&bits, p, sizeof(bits));
+	__m128i zero = _mm_setzero_si128();
+	__m128i wide = _mm_unpacklo_epi16(
+		_mm_unpacklo_epi8(_mm_cvtsi32_si128(bits), zero), zero);
+	return _mm_mul_ps(_mm_cvtepi32_ps(wide), _mm_set1_ps(1.0f / 255.0f));
+}
+
+static void DownsampleRowSSE(const uint8_t * row0, const uint8_t * row1,
+		uint32_t width, uint32_t dstWidth, uint8_t * dst, bool srgb) {
+	const imMipTables &tables = Tables();
+	const __m128 quarter = _mm_set1_ps(0.25f);
+	const __m128 unormScale = _mm_set1_ps(255.0f);
+	const __m128 encodeScale = _mm_set1_ps(static_cast<float>(ENCODE_STEPS));
+
+	for (uint32_t x = 0; x < dstWidth; x++) {
+		uint32_t x0 = std::min(2 * x, width - 1) * 4;
+		uint32_t x1 = std::min(2 * x + 1, width - 1) * 4;
+
+		// Same order of operations as the scalar kernel, for identical results.
+		__m128 sum = _mm_mul_ps(_mm_add_ps(
+			_mm_add_ps(LoadPixel(row0 + x0, srgb), LoadPixel(row0 + x1, srgb)),
+			_mm_add_ps(LoadPixel(row1 + x0, srgb), LoadPixel(row1 + x1, srgb))),
+			quarter);
+
+		__m128i unorm = _mm_cvtps_epi32(_mm_mul_ps(sum, unormScale));
+		__m128i packed = _mm_packus_epi16(_mm_packs_epi32(unorm, unorm), unorm);
+		int32_t bits = _mm_cvtsi128_si32(packed);
+		memcpy(dst + x * 4, &bits, sizeof(bits));
+
+		if (srgb) {
+			alignas(16) int32_t steps[4];
+			_mm_store_si128(reinterpret_cast<__m128i *>(steps),
+				_mm_cvtps_epi32(_mm_mul_ps(sum, encodeScale)));
+			dst[x * 4 + 0] = tables.linearToSrgb[steps[0]];
+			dst[x * 4 + 1] = tables.linearToSrgb[steps[1]];
+			dst[x * 4 + 2] = tables.linearToSrgb[steps[2]];
+		}
+	}
+}
+
+#endif
+
+void imMipChain::Generate(const uint8_t * pixels, uint32_t width, uint32_t height,
+		uint32_t levelCount, bool srgb, imMipPath path) {
+	levels.clear();
+	levels.resize(std::max(levelCount, 1u));
+	levels[0].assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+
+	for (uint32_t level = 1; level < levels.size(); level++) {
+		uint32_t dstWidth = std::max(width / 2, 1u);
+		uint32_t dstHeight = std::max(height / 2, 1u);
+
+		levels[level].resize(static_cast<size_t>(dstWidth) * dstHeight * 4);
+		Downsample(levels[level - 1].data(), width, height,
+			levels[level].data(), srgb, path);
+
+		width = dstWidth;
+		height = dstHeight;
+	}
+}
+
+uint32_t imMipChain::LevelsFor(uint32_t width, uint32_t height) {
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size /= 2) {
+		levels++;
+	}
+
+	return levels;
+}
+
+void imMipChain::Downsample(const uint8_t * src, uint32_t width, uint32_t height,
+		uint8_t * dst, bool srgb, imMipPath path) {
+	// Never run a kernel this CPU can't execute.
+	if (path == IM_MIP_BEST || path > BestPath()) {
+		path = BestPath();
+	}
+
+	uint32_t dstWidth = std::max(width / 2, 1u);
+	uint32_t dstHeight = std::max(height / 2, 1u);
+	size_t stride = static_cast<size_t>(width) * 4;
+
+	for (uint32_t y = 0; y < dstHeight; y++) {
+		const uint8_t * row0 = src + std::min(2 * y, height - 1) * stride;
+		const uint8_t * row1 = src + std::min(2 * y + 1, height - 1) * stride;
+		uint8_t * out = dst + static_cast<size_t>(y) * dstWidth * 4;
+
+#ifdef IM_MIP_X86
+		if (path == IM_MIP_SSE) {
+			DownsampleRowSSE(row0, row1, width, dstWidth, out, srgb);
+			continue;
+		}
+#endif
+
+		DownsampleRowScalar(row0, row1, width, dstWidth, out, srgb);
+	}
+}
+
+imMipPath imMipChain::BestPath() {
+#ifdef IM_MIP_X86
+	return IM_MIP_SSE;
+#else
+	return IM_MIP_SCALAR;
+#endif
+}
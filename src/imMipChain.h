@@ -0,0 +1,52 @@
+#ifndef IM_MIP_CHAIN_H
+#define IM_MIP_CHAIN_H
+
+#include "PREFIX.h"
+
+/// Kernel used to downsample mip levels on the CPU.
+enum imMipPath {
+	/// Reference implementation, one channel at a time.
+	IM_MIP_SCALAR,
+	/// Every channel of a pixel at once.
+	IM_MIP_SSE,
+	/// Widest kernel the running CPU supports.
+	IM_MIP_BEST
+};
+
+/// Mip levels of an RGBA8 image built on the CPU, for formats the GPU can't
+/// blit with linear filtering. Each level is a 2x2 box filter of the one
+/// above, a side already 1 texel long stays that way. sRGB images are
+/// filtered in linear space, as a blit of an sRGB format would be, so
+/// distant textures don't darken.
+class imMipChain {
+public:
+	/// Build 'levelCount' levels from tightly packed level 0 'pixels'.
+	void Generate(const uint8_t * pixels, uint32_t width, uint32_t height,
+		uint32_t levelCount, bool srgb, imMipPath path = IM_MIP_BEST);
+
+	uint32_t LevelCount() const { return static_cast<uint32_t>(levels.size()); }
+	const uint8_t * Level(uint32_t level) const { return levels[level].data(); }
+	size_t LevelSize(uint32_t level) const { return levels[level].size(); }
+	/// Hand every level over to the caller, leaving the chain empty.
+	std::vector<std::vector<uint8_t>> Release() {
+		std::vector<std::vector<uint8_t>> released;
+		released.swap(levels);
+		return released;
+	}
+
+	/// Levels in a full chain, down to 1x1.
+	static uint32_t LevelsFor(uint32_t width, uint32_t height);
+
+	/// Halve 'src' into 'dst', which holds max(1, width / 2) by
+	/// max(1, height / 2) pixels. Every path writes the same result.
+	static void Downsample(const uint8_t * src, uint32_t width, uint32_t height,
+		uint8_t * dst, bool srgb, imMipPath path = IM_MIP_BEST);
+
+	/// Widest kernel the running CPU supports.
+	static imMipPath BestPath();
+
+private:
+	std::vector<std::vector<uint8_t>> levels;
+};
+
+#endif
@@ -1,7 +1,11 @@
 #include "imPipeline.h"
 #include "imVertex.hpp"
+#include "imPipelineCache.h"
+#include "imLayoutCache.h"
 
-static std::vector<char> ReadFile(const std::string &filename) {
+#include <algorithm>
+
+std::vector<char> ReadFile(const std::string &filename) {
 	// Start at the end of the file, we can immediately judge the size.
 	std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
@@ -21,38 +25,452 @@ static std::vector<char> ReadFile(const std::string &filename) {
 	return buffer;
 }
 
-void imPipeline::CreateGraphicsPipeline(VkExtent2D extent,
-		std::string vertexFile, std::string fragFile,
-		VkDescriptorSetLayout &setLayout) {
-	auto vertCode = ReadFile(vertexFile);
-	auto fragCode = ReadFile(fragFile);
+/// Fold the raw bytes of 'value' into an FNV-1a hash.
+template <typename T>
+static void HashBytes(size_t &hash, const T * value, size_t size) {
+	const unsigned char * bytes = reinterpret_cast<const unsigned char *>(value);
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+}
 
-	std::cout << "-----------------------------------------------" << std::endl;
-	std::cout << "Loaded Shader " << vertexFile << " with size (" 
-		<< vertCode.size() << ")." << std::endl;
-	std::cout << "Loaded Shader " << fragFile << " with size (" 
-		<< fragCode.size() << ")." << std::endl;
-	std::cout << "-----------------------------------------------" << std::endl;
+template <typename T>
+static void HashField(size_t &hash, const T &value) {
+	HashBytes(hash, &value, sizeof(value));
+}
+
+static void HashField(size_t &hash, const std::string &value) {
+	HashBytes(hash, value.data(), value.size());
+	// Terminate so "ab" + "c" and "a" + "bc" differ.
+	HashField(hash, value.size());
+}
+
+bool imPipelineDesc::operator==(const imPipelineDesc &other) const {
+	return vertexShader == other.vertexShader &&
+		fragmentShader == other.fragmentShader &&
+		vertexLayout == other.vertexLayout &&
+		topology == other.topology &&
+		polygonMode == other.polygonMode &&
+		cullMode == other.cullMode &&
+		frontFace == other.frontFace &&
+		depthTest == other.depthTest &&
+		depthWrite == other.depthWrite &&
+		depthCompareOp == other.depthCompareOp &&
+		blendEnable == other.blendEnable &&
+		srcColorBlendFactor == other.srcColorBlendFactor &&
+		dstColorBlendFactor == other.dstColorBlendFactor &&
+		colorBlendOp == other.colorBlendOp &&
+		srcAlphaBlendFactor == other.srcAlphaBlendFactor &&
+		dstAlphaBlendFactor == other.dstAlphaBlendFactor &&
+		alphaBlendOp == other.alphaBlendOp &&
+		colorWriteMask == other.colorWriteMask &&
+		renderPass == other.renderPass &&
+		subpass == other.subpass &&
+		layout == other.layout &&
+		specialization == other.specialization;
+}
+
+imPipelineDesc & imPipelineDesc::Specialize(imSpecConstant id, bool value) {
+	specialization[id] = value ? VK_TRUE : VK_FALSE;
+	return *this;
+}
+
+imPipelineDesc & imPipelineDesc::Specialize(imSpecConstant id, uint32_t value) {
+	specialization[id] = value;
+	return *this;
+}
+
+imPipelineDesc & imPipelineDesc::Specialize(imSpecConstant id, float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	specialization[id] = bits;
+	return *this;
+}
+
+size_t imPipelineDesc::Hash() const {
+	size_t hash = 14695981039346656037ull;
+	HashField(hash, vertexShader);
+	HashField(hash, fragmentShader);
+	HashField(hash, vertexLayout);
+	HashField(hash, topology);
+	HashField(hash, polygonMode);
+	HashField(hash, cullMode);
+	HashField(hash, frontFace);
+	HashField(hash, depthTest);
+	HashField(hash, depthWrite);
+	HashField(hash, depthCompareOp);
+	HashField(hash, blendEnable);
+	HashField(hash, srcColorBlendFactor);
+	HashField(hash, dstColorBlendFactor);
+	HashField(hash, colorBlendOp);
+	HashField(hash, srcAlphaBlendFactor);
+	HashField(hash, dstAlphaBlendFactor);
+	HashField(hash, alphaBlendOp);
+	HashField(hash, colorWriteMask);
+	HashField(hash, renderPass);
+	HashField(hash, subpass);
+	HashField(hash, layout);
+	for (const auto &constant : specialization) {
+		HashField(hash, constant.first);
+		HashField(hash, constant.second);
+	}
+	return hash;
+}
+
+imPipelineDesc imPipeline::Describe(const std::string &vertexFile,
+		const std::string &fragFile) {
+	imPipelineDesc desc;
+	desc.vertexShader = vertexFile;
+	desc.fragmentShader = fragFile;
+	desc.renderPass = renderPass;
+
+	std::shared_ptr<const Shader> vert = LoadShader(vertexFile);
+	std::shared_ptr<const Shader> frag = LoadShader(fragFile);
+	desc.layout = layoutCache.Get({ &vert->reflection, &frag->reflection });
+	return desc;
+}
+
+VkPipeline imPipeline::Get(const imPipelineDesc &desc) {
+	std::unique_lock<std::mutex> lock(mutex);
+	auto it = pipelines.find(desc);
+
+	if (it == pipelines.end()) {
+		// Compile right here, queueing it would only mean waiting for it.
+		misses++;
+		compiling++;
+		pipelines.emplace(desc, Entry());
+		lock.unlock();
+		Compile(desc);
+		lock.lock();
+		it = pipelines.find(desc);
+	} else {
+		hits++;
+	}
+
+	// References into the map survive rehashing, unlike iterators.
+	Entry &entry = it->second;
+	if (!entry.ready) {
+		stalls++;
+		compiled.wait(lock, [&entry] { return entry.ready; });
+	}
+
+	if (!entry.error.empty()) {
+		throw std::runtime_error(entry.error);
+	}
+
+	return entry.pipeline;
+}
+
+VkPipeline imPipeline::GetOrFallback(const imPipelineDesc &desc,
+		const imPipelineDesc &fallback) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = pipelines.find(desc);
+		if (it != pipelines.end() && it->second.ready && it->second.error.empty()) {
+			hits++;
+			return it->second.pipeline;
+		}
+
+		fallbacks++;
+	}
+
+	Request(desc);
+	return Get(fallback);
+}
+
+void imPipeline::Request(const imPipelineDesc &desc, imThreadPool &pool) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (pipelines.count(desc) != 0) {
+			return;
+		}
+
+		misses++;
+		compiling++;
+		pipelines.emplace(desc, Entry());
+	}
+
+	pool.Submit([this, desc] { Compile(desc); });
+}
+
+bool imPipeline::Ready(const imPipelineDesc &desc) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = pipelines.find(desc);
+	return it != pipelines.end() && it->second.ready;
+}
+
+void imPipeline::WaitIdle() {
+	std::unique_lock<std::mutex> lock(mutex);
+	compiled.wait(lock, [this] { return compiling == 0; });
+}
+
+void imPipeline::Compile(const imPipelineDesc &desc) {
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	std::string error;
+
+	try {
+		pipeline = CreateGraphicsPipeline(desc);
+	} catch (const std::exception &e) {
+		error = e.what();
+	}
+
+	uint32_t generation = 0;
+	bool rebuild = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Entry &entry = pipelines[desc];
+		entry.pipeline = pipeline;
+		entry.error = error;
+		entry.ready = true;
+
+		// Reloaded while compiling, so rebuild with the new module. The
+		// rebuild takes over this compile's count in 'compiling'.
+		if (entry.stale && error.empty()) {
+			rebuild = true;
+			generation = ++entry.generation;
+		} else {
+			compiling--;
+		}
+
+		entry.stale = false;
+	}
+
+	compiled.notify_all();
+
+	if (rebuild) {
+		threadPool.Submit([this, desc, generation] { Rebuild(desc, generation); });
+	}
+}
+
+void imPipeline::DestroyPipelines() {
+	WaitIdle();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto &entry : pipelines) {
+		if (entry.second.pipeline != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, entry.second.pipeline, nullptr);
+		}
+
+		if (entry.second.reloaded != VK_NULL_HANDLE) {
+			vkDestroyPipeline(device, entry.second.reloaded, nullptr);
+		}
+	}
+
+	for (auto &old : retired) {
+		vkDestroyPipeline(device, old.pipeline, nullptr);
+	}
+
+	pipelines.clear();
+	retired.clear();
+}
+
+void imPipeline::Reload(const std::string &file) {
+	std::shared_ptr<Shader> shader = std::make_shared<Shader>();
+	std::vector<char> code;
+
+	try {
+		code = ReadFile(file);
+		shader->reflection.Parse(code);
+	} catch (const std::exception &e) {
+		std::cerr << "Failed to reload " << file << ": " << e.what() << std::endl;
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(shaderMutex);
+		auto it = shaders.find(file);
+		if (it == shaders.end()) {
+			// Never loaded, so no pipeline uses it yet.
+			return;
+		}
+
+		if (!it->second->reflection.SameInterface(shader->reflection)) {
+			std::cerr << "The interface of " << file << " changed, restart to pick it up."
+				<< std::endl;
+			return;
+		}
+
+		// Compiles may still be reading the old module, keep it until they
+		// finish. They hold their own pointer, so swapping ours is safe.
+		shader->module = CreateShaderModule(code);
+		retiredModules.push_back(it->second->module);
+		it->second = shader;
+	}
+
+	std::vector<std::pair<imPipelineDesc, uint32_t>> affected;
+	uint32_t stale = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto &entry : pipelines) {
+			const imPipelineDesc &desc = entry.first;
+			if (desc.vertexShader != file && desc.fragmentShader != file) {
+				continue;
+			}
+
+			// Still compiling, possibly with the old module, Compile() queues
+			// the rebuild once it lands.
+			if (!entry.second.ready) {
+				entry.second.stale = true;
+				stale++;
+				continue;
+			}
+
+			// Pipelines that failed to compile have nothing to replace.
+			if (!entry.second.error.empty()) {
+				continue;
+			}
+
+			compiling++;
+			affected.push_back(std::make_pair(desc, ++entry.second.generation));
+		}
+	}
+
+	std::cout << "Reloaded " << file << ", rebuilding " << affected.size() 
+		<< " pipeline" << (affected.size() == 1 ? "" : "s") << " now and "
+		<< stale << " once compiled" << std::endl;
+
+	for (auto &rebuild : affected) {
+		imPipelineDesc desc = rebuild.first;
+		uint32_t generation = rebuild.second;
+		threadPool.Submit([this, desc, generation] { Rebuild(desc, generation); });
+	}
+}
+
+void imPipeline::Rebuild(const imPipelineDesc &desc, uint32_t generation) {
+	VkPipeline pipeline = VK_NULL_HANDLE;
 
-	VkShaderModule vertModule;
-	VkShaderModule fragModule;
+	try {
+		pipeline = CreateGraphicsPipeline(desc);
+	} catch (const std::exception &e) {
+		// Keep drawing with the old pipeline.
+		std::cerr << "Failed to rebuild pipeline: " << e.what() << std::endl;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Entry &entry = pipelines[desc];
+
+		if (pipeline != VK_NULL_HANDLE && generation != entry.generation) {
+			// A newer reload superseded this one, never used so destroy it now.
+			vkDestroyPipeline(device, pipeline, nullptr);
+		} else if (pipeline != VK_NULL_HANDLE) {
+			if (entry.reloaded != VK_NULL_HANDLE) {
+				vkDestroyPipeline(device, entry.reloaded, nullptr);
+			}
+			entry.reloaded = pipeline;
+		}
+
+		compiling--;
+	}
+
+	compiled.notify_all();
+}
+
+uint32_t imPipeline::Update(uint64_t frameNumber) {
+	uint32_t swapped = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto &entry : pipelines) {
+			if (entry.second.reloaded == VK_NULL_HANDLE) {
+				continue;
+			}
+
+			// Frames already submitted may still use the old one.
+			Retired old;
+			old.pipeline = entry.second.pipeline;
+			old.frame = frameNumber;
+			retired.push_back(old);
+
+			entry.second.pipeline = entry.second.reloaded;
+			entry.second.reloaded = VK_NULL_HANDLE;
+			swapped++;
+		}
+
+		if (compiling == 0) {
+			std::lock_guard<std::mutex> shaderLock(shaderMutex);
+			for (VkShaderModule module : retiredModules) {
+				vkDestroyShaderModule(device, module, nullptr);
+			}
+			retiredModules.clear();
+		}
+	}
+
+	// Same rule as the swap chain, a frame's fence has signalled once
+	// we are MAX_FRAMES_IN_FLIGHT frames past it.
+	while (!retired.empty() && 
+			frameNumber >= retired.front().frame + MAX_FRAMES_IN_FLIGHT) {
+		vkDestroyPipeline(device, retired.front().pipeline, nullptr);
+		retired.erase(retired.begin());
+	}
+
+	if (swapped > 0) {
+		std::cout << "Swapped in " << swapped << " rebuilt pipeline"
+			<< (swapped == 1 ? "" : "s") << " at frame " << frameNumber << std::endl;
+		std::cout << "-----------------------------------------------" << std::endl;
+	}
+
+	return swapped;
+}
+
+std::shared_ptr<const imPipeline::Shader> imPipeline::LoadShader(const std::string &file) {
+	std::lock_guard<std::mutex> lock(shaderMutex);
+	auto it = shaders.find(file);
+	if (it != shaders.end()) {
+		return it->second;
+	}
+
+	auto code = ReadFile(file);
+	std::cout << "Loaded Shader " << file << " with size (" 
+		<< code.size() << ")." << std::endl;
+
+	std::shared_ptr<Shader> shader = std::make_shared<Shader>();
+	shader->reflection.Parse(code);
+	shader->module = CreateShaderModule(code);
+	shaders[file] = shader;
+	return shader;
+}
 
-	vertModule = CreateShaderModule(vertCode);
-	fragModule = CreateShaderModule(fragCode);
+VkPipeline imPipeline::CreateGraphicsPipeline(const imPipelineDesc &desc) {
+	// Held for the whole build, a reload may swap the map entries meanwhile.
+	std::shared_ptr<const Shader> vert = LoadShader(desc.vertexShader);
+	std::shared_ptr<const Shader> frag = LoadShader(desc.fragmentShader);
+
+	// Constants are tightly packed in id order, each stage picks out the
+	// ids it declares and ignores the rest.
+	std::vector<VkSpecializationMapEntry> specEntries;
+	std::vector<uint32_t> specData;
+	for (const auto &constant : desc.specialization) {
+		VkSpecializationMapEntry entry = { };
+		entry.constantID = constant.first;
+		entry.offset = static_cast<uint32_t>(specData.size() * sizeof(uint32_t));
+		entry.size = sizeof(uint32_t);
+		specEntries.push_back(entry);
+		specData.push_back(constant.second);
+	}
+
+	VkSpecializationInfo specInfo = { };
+	specInfo.mapEntryCount = static_cast<uint32_t>(specEntries.size());
+	specInfo.pMapEntries = specEntries.data();
+	specInfo.dataSize = specData.size() * sizeof(uint32_t);
+	specInfo.pData = specData.data();
+	const VkSpecializationInfo * pSpecInfo = specEntries.empty() ? nullptr : &specInfo;
 
 	// Create info for the vertex shader stage.
 	VkPipelineShaderStageCreateInfo vertShaderStageInfo = { };
 	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vertModule;
+	vertShaderStageInfo.module = vert->module;
 	vertShaderStageInfo.pName = "main";
+	vertShaderStageInfo.pSpecializationInfo = pSpecInfo;
 
 	// Create info for the fragment shader stage.
 	VkPipelineShaderStageCreateInfo fragShaderStageInfo = { };
 	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = fragModule;
+	fragShaderStageInfo.module = frag->module;
 	fragShaderStageInfo.pName = "main";
+	fragShaderStageInfo.pSpecializationInfo = pSpecInfo;
 
 	VkPipelineShaderStageCreateInfo shaderStages[] = {
 		vertShaderStageInfo, fragShaderStageInfo
@@ -60,43 +478,78 @@ void imPipeline::CreateGraphicsPipeline(VkExtent2D extent,
 
 	// We have all the programmable stages set up, now we only need to set
 	// up the fixed function stages of the pipeline.
-	auto bindingDesc = imVertex::GetBindingDescription();
-	auto attrDesc = imVertex::GetAttrDescription();
+	// Binding 0 advances per vertex, binding 1 per instance.
+	std::vector<VkVertexInputBindingDescription> layoutBindings = {
+		imVertex::GetBindingDescription()
+	};
+
+	auto vertexAttr = imVertex::GetAttrDescription();
+	std::vector<VkVertexInputAttributeDescription> layoutAttr(
+		vertexAttr.begin(), vertexAttr.end());
+
+	if (desc.vertexLayout == IM_VERTEX_LAYOUT_INSTANCED) {
+		auto instanceAttr = imInstance::GetAttrDescription();
+		layoutBindings.push_back(imInstance::GetBindingDescription());
+		layoutAttr.insert(layoutAttr.end(), instanceAttr.begin(), instanceAttr.end());
+	}
+
+	// Only the attributes the vertex shader actually reads, and the
+	// bindings they come from.
+	std::vector<VkVertexInputAttributeDescription> attrDesc;
+	for (const imReflectedInput &input : vert->reflection.inputs) {
+		auto attr = std::find_if(layoutAttr.begin(), layoutAttr.end(),
+			[&input](const VkVertexInputAttributeDescription &attr) {
+				return attr.location == input.location;
+			});
+
+		if (attr == layoutAttr.end()) {
+			throw std::runtime_error("Vertex shader reads an attribute the vertex layout lacks!");
+		}
+
+		if (attr->format != input.format) {
+			throw std::runtime_error("Vertex shader attribute format does not match the vertex layout!");
+		}
+
+		attrDesc.push_back(*attr);
+	}
+
+	std::vector<VkVertexInputBindingDescription> bindingDesc;
+	for (const auto &binding : layoutBindings) {
+		bool used = std::any_of(attrDesc.begin(), attrDesc.end(),
+			[&binding](const VkVertexInputAttributeDescription &attr) {
+				return attr.binding == binding.binding;
+			});
+
+		if (used) {
+			bindingDesc.push_back(binding);
+		}
+	}
 
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo = { };
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	vertexInputInfo.vertexBindingDescriptionCount = 
+		static_cast<uint32_t>(bindingDesc.size());
 	vertexInputInfo.vertexAttributeDescriptionCount = 
 		static_cast<uint32_t>(attrDesc.size());
 
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDesc;
+	vertexInputInfo.pVertexBindingDescriptions = bindingDesc.data();
 	vertexInputInfo.pVertexAttributeDescriptions = attrDesc.data();
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly = { };
 	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssembly.topology = desc.topology;
 	inputAssembly.primitiveRestartEnable = VK_FALSE;
 
 	// --- Viewport & Scissors ---
 
-	VkViewport viewport = { };
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float)extent.width;
-	viewport.height = (float)extent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	VkRect2D scissor = { };
-	scissor.offset = { 0, 0 };
-	scissor.extent = extent;
-
+	// Both are dynamic state set while recording, so the pipeline does not
+	// depend on the swap chain extent and survives a resize.
 	VkPipelineViewportStateCreateInfo viewportState = { };
 	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
+	viewportState.pViewports = nullptr;
 	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
+	viewportState.pScissors = nullptr;
 
 	// --- Rasterization ---
 
@@ -104,11 +557,11 @@ void imPipeline::CreateGraphicsPipeline(VkExtent2D extent,
 	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
 	rasterizer.depthClampEnable = VK_FALSE;
 	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.polygonMode = desc.polygonMode;
 	rasterizer.lineWidth = 1.0f;
 
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;;
-	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizer.cullMode = desc.cullMode;
+	rasterizer.frontFace = desc.frontFace;
 
 	rasterizer.depthBiasEnable = VK_FALSE;
 	rasterizer.depthBiasConstantFactor = 0.0f; // Optional
@@ -130,16 +583,14 @@ void imPipeline::CreateGraphicsPipeline(VkExtent2D extent,
 
 	// --- Color Blending ---
 	VkPipelineColorBlendAttachmentState colorBlendAttachment = { };
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT 
-		| VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
-	// The following are OPTIONAL, since we're disabling blending.
-	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.colorWriteMask = desc.colorWriteMask;
+	colorBlendAttachment.blendEnable = desc.blendEnable;
+	colorBlendAttachment.srcColorBlendFactor = desc.srcColorBlendFactor;
+	colorBlendAttachment.dstColorBlendFactor = desc.dstColorBlendFactor;
+	colorBlendAttachment.colorBlendOp = desc.colorBlendOp;
+	colorBlendAttachment.srcAlphaBlendFactor = desc.srcAlphaBlendFactor;
+	colorBlendAttachment.dstAlphaBlendFactor = desc.dstAlphaBlendFactor;
+	colorBlendAttachment.alphaBlendOp = desc.alphaBlendOp;
 
 	VkPipelineColorBlendStateCreateInfo colorBlending = { };
 	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -154,13 +605,10 @@ void imPipeline::CreateGraphicsPipeline(VkExtent2D extent,
 	colorBlending.blendConstants[3] = 0.0f; // Optional
 
 	// --- Dynamic State ---
-	// I'm setting this up here as an example,
-	// but below pipelineInfo.pDynamicState is set to nullptr
-	// so we're not actually using this code.
 	
 	VkDynamicState dynamicStates[] = {
 		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_LINE_WIDTH
+		VK_DYNAMIC_STATE_SCISSOR
 	};
 
 	VkPipelineDynamicStateCreateInfo dynamicState = { };
@@ -168,27 +616,13 @@ void imPipeline::CreateGraphicsPipeline(VkExtent2D extent,
 	dynamicState.dynamicStateCount = 2;
 	dynamicState.pDynamicStates = dynamicStates;
 
-	// --- Pipeline Layout ---
-	
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo = { };
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 1;
-	pipelineLayoutInfo.pSetLayouts = &setLayout;
-	pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-	pipelineLayoutInfo.pPushConstantRanges = 0; // Optional
-
-	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) 
-			!= VK_SUCCESS) {
-		throw std::runtime_error("Failed to create pipeline layout!");
-	}
-
 	// --- Depth / Stencil ---
 	
 	VkPipelineDepthStencilStateCreateInfo depthStencil = { };
 	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencil.depthTestEnable = VK_TRUE;
-	depthStencil.depthWriteEnable = VK_TRUE;
-	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+	depthStencil.depthTestEnable = desc.depthTest;
+	depthStencil.depthWriteEnable = desc.depthWrite;
+	depthStencil.depthCompareOp = desc.depthCompareOp;
 	depthStencil.depthBoundsTestEnable = VK_FALSE;
 	depthStencil.minDepthBounds = 0.0f; // Optional
 	depthStencil.maxDepthBounds = 1.0f; // Optional
@@ -210,22 +644,24 @@ void imPipeline::CreateGraphicsPipeline(VkExtent2D extent,
 	pipelineInfo.pMultisampleState = &multisampling;
 	pipelineInfo.pDepthStencilState = &depthStencil;
 	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = nullptr; // Optional
-	pipelineInfo.layout = pipelineLayout;
-	pipelineInfo.renderPass = renderPass;
-	pipelineInfo.subpass = 0;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = desc.layout;
+	pipelineInfo.renderPass = desc.renderPass;
+	pipelineInfo.subpass = desc.subpass;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
 	pipelineInfo.basePipelineIndex = -1; // Optional
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, 
-			nullptr, &graphicsPipeline) != VK_SUCCESS) {
+	VkPipeline pipeline;
+	VkResult result = usePipelineCache
+		? pipelineCache.CreateGraphicsPipelines(1, &pipelineInfo, &pipeline)
+		: vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, 
+			nullptr, &pipeline);
+
+	if (result != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create graphics pipeline!");
 	}
-	
-	// --- Cleanup ---
 
-	vkDestroyShaderModule(device, fragModule, nullptr);
-	vkDestroyShaderModule(device, vertModule, nullptr);
+	return pipeline;
 }
 
 void imPipeline::CreateRenderPass(VkFormat format) {
@@ -292,6 +728,23 @@ void imPipeline::CreateRenderPass(VkFormat format) {
 	}
 }
 
+void imPipeline::SetViewport(VkCommandBuffer commandBuffer, VkExtent2D extent) {
+	VkViewport viewport = { };
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float)extent.width;
+	viewport.height = (float)extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = { };
+	scissor.offset = { 0, 0 };
+	scissor.extent = extent;
+
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
 VkShaderModule imPipeline::CreateShaderModule(const std::vector<char> &code) {
 	VkShaderModuleCreateInfo createInfo = { };
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -306,8 +759,25 @@ VkShaderModule imPipeline::CreateShaderModule(const std::vector<char> &code) {
 	return shaderModule;
 }
 
+void imPipeline::PrintStats() {
+	std::cout << "Pipelines: " << pipelines.size() << " live, " << hits << " hit"
+		<< (hits == 1 ? "" : "s") << ", " << misses << " miss"
+		<< (misses == 1 ? "" : "es") << ", " << stalls << " stalled, " 
+		<< fallbacks << " fell back" << std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
+}
+
 void imPipeline::Cleanup() {
-	vkDestroyPipeline(device, graphicsPipeline, nullptr);
-	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	DestroyPipelines();
+	for (auto &entry : shaders) {
+		vkDestroyShaderModule(device, entry.second->module, nullptr);
+	}
+
+	for (VkShaderModule module : retiredModules) {
+		vkDestroyShaderModule(device, module, nullptr);
+	}
+
+	shaders.clear();
+	retiredModules.clear();
 	vkDestroyRenderPass(device, renderPass, nullptr);
 }
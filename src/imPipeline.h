@@ -3,29 +3,212 @@
 
 #include "PREFIX.h"
 #include "imVulkan.h"
+#include "imThreadPool.h"
+#include "imShaderReflection.h"
 
-static std::vector<char> ReadFile(const std::string &filename);
+#include <map>
+#include <memory>
+#include <unordered_map>
 
+/// Read the entire contents of a binary file, such as compiled SPIR-V.
+std::vector<char> ReadFile(const std::string &filename);
+
+/// Vertex buffers a pipeline reads from.
+enum imVertexLayout {
+	/// imVertex at binding 0 only.
+	IM_VERTEX_LAYOUT_MESH,
+	/// imVertex at binding 0 and imInstance at binding 1.
+	IM_VERTEX_LAYOUT_INSTANCED
+};
+
+/// Specialization constant ids, matching the constant_id layouts in the shaders.
+enum imSpecConstant {
+	/// bool, sample the texture in shader.frag.
+	IM_SPEC_TEXTURED = 0,
+	/// bool, multiply in the interpolated vertex color in shader.frag.
+	IM_SPEC_VERTEX_COLOR = 1,
+	/// float, how much of the per instance tint to apply in shader.frag.
+	IM_SPEC_TINT_STRENGTH = 2
+};
+
+/// Everything that distinguishes one graphics pipeline from another, two
+/// equal descriptions always share a single VkPipeline. Defaults match the
+/// opaque, depth tested mesh pipeline.
+struct imPipelineDesc {
+	std::string vertexShader;
+	std::string fragmentShader;
+	imVertexLayout vertexLayout = IM_VERTEX_LAYOUT_INSTANCED;
+
+	// --- Rasterization ---
+	VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+	VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+	VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	// --- Depth ---
+	VkBool32 depthTest = VK_TRUE;
+	VkBool32 depthWrite = VK_TRUE;
+	VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+
+	// --- Color Blending ---
+	VkBool32 blendEnable = VK_FALSE;
+	VkBlendFactor srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	VkBlendFactor dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+	VkBlendOp colorBlendOp = VK_BLEND_OP_ADD;
+	VkBlendFactor srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	VkBlendFactor dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	VkBlendOp alphaBlendOp = VK_BLEND_OP_ADD;
+	VkColorComponentFlags colorWriteMask = VK_COLOR_COMPONENT_R_BIT
+		| VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+	// --- Render Pass & Layout ---
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	uint32_t subpass = 0;
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+
+	// --- Specialization ---
+	/// Raw 32 bit value of each specialization constant, by constant id, given
+	/// to every stage. Unset constants keep the default declared in the shader.
+	std::map<uint32_t, uint32_t> specialization;
+
+	/// Set a bool specialization constant.
+	imPipelineDesc & Specialize(imSpecConstant id, bool value);
+	/// Set an int or uint specialization constant.
+	imPipelineDesc & Specialize(imSpecConstant id, uint32_t value);
+	/// Set a float specialization constant.
+	imPipelineDesc & Specialize(imSpecConstant id, float value);
+
+	bool operator==(const imPipelineDesc &other) const;
+	bool operator!=(const imPipelineDesc &other) const { return !(*this == other); }
+	/// FNV-1a over every field.
+	size_t Hash() const;
+};
+
+/// Lets imPipelineDesc key an unordered_map.
+struct imPipelineDescHash {
+	size_t operator()(const imPipelineDesc &desc) const { return desc.Hash(); }
+};
+
+/// Owns the render pass and pipeline layout along with every graphics
+/// pipeline built against them. Pipelines are requested by description
+/// through Get() and compiled at most once per unique description, either
+/// on the calling thread or ahead of time on a thread pool via Request().
 class imPipeline {
 public:
-	void CreateDescriptorSetLayout();
-	void CreateGraphicsPipeline(VkExtent2D extent,
-		std::string vertexFile, std::string fragFile,
-		VkDescriptorSetLayout &setLayout);
 	void CreateRenderPass(VkFormat format);
+
+	/// Default description for the given shaders using our render pass. The
+	/// pipeline layout is reflected from the shaders, via the layout cache.
+	imPipelineDesc Describe(const std::string &vertexFile, const std::string &fragFile);
+	/// Pipeline matching 'desc', compiled on the first request and shared after that.
+	/// Waits if it is still compiling in the background.
+	/// Viewport and scissor are dynamic, so pipelines are independent of
+	/// the swap chain extent and set with SetViewport() while recording.
+	VkPipeline Get(const imPipelineDesc &desc);
+	/// Pipeline matching 'desc' if it has finished compiling, otherwise queue
+	/// it and return Get(fallback) so the draw can go ahead without stalling.
+	VkPipeline GetOrFallback(const imPipelineDesc &desc, const imPipelineDesc &fallback);
+	/// Start compiling 'desc' on 'pool' unless it is already built or queued.
+	void Request(const imPipelineDesc &desc, imThreadPool &pool = threadPool);
+	/// True if 'desc' has finished compiling.
+	bool Ready(const imPipelineDesc &desc);
+	/// Block until every requested pipeline has finished compiling.
+	void WaitIdle();
+	/// Destroy every cached pipeline, for instance before the render pass is replaced.
+	/// Waits for background compiles, the caller must ensure none of the
+	/// pipelines are still in use by the device.
+	void DestroyPipelines();
+
+	/// Reload the SPIR-V 'file' and rebuild every pipeline using it in the
+	/// background, the old pipelines keep drawing until Update() swaps them.
+	/// A module whose interface changed is rejected, since descriptor sets
+	/// and vertex buffers are set up for the old one.
+	void Reload(const std::string &file);
+	/// Call at each frame boundary, once the frame's fence has signalled. Swaps
+	/// in rebuilt pipelines and destroys replaced ones no frame in flight uses.
+	/// Returns how many were swapped in, pipelines kept from Get() are stale then.
+	uint32_t Update(uint64_t frameNumber);
+
+	/// Record the viewport and scissor covering the given extent.
+	static void SetViewport(VkCommandBuffer commandBuffer, VkExtent2D extent);
+
+	/// Print cache hits, misses, stalls and fallbacks.
+	void PrintStats();
 	void Cleanup();
 
-	/// Describes a particular configuration of the graphics pipeline,
-	/// holding all saders, fixed function states, render passes, etc.
-	VkPipeline graphicsPipeline;
 	/// Describes how attachments are used during subpasses in the rendering process.
 	VkRenderPass renderPass;
-	/// Layout for uniforms in the graphics pipeline.
-	VkPipelineLayout pipelineLayout;
+
+	/// Requests served by an existing pipeline.
+	uint32_t hits = 0;
+	/// Requests that had to compile a new pipeline.
+	uint32_t misses = 0;
+	/// Get() calls that waited on a background compile.
+	uint32_t stalls = 0;
+	/// GetOrFallback() calls that used the fallback.
+	uint32_t fallbacks = 0;
+
+	/// Compile against the shared VkPipelineCache. Disabled while
+	/// benchmarking, so every run measures a cold compile.
+	bool usePipelineCache = true;
+
+	/// Wrap SPIR-V code in a shader module, the caller destroys it.
+	static VkShaderModule CreateShaderModule(const std::vector<char> &code);
 
 private:
-	VkShaderModule CreateShaderModule(const std::vector<char> &code);
+	struct Entry {
+		/// Null until compiled.
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		bool ready = false;
+		/// Set if compiling failed, rethrown by Get().
+		std::string error;
+		/// Rebuilt after a reload, waiting for Update() to swap it in.
+		VkPipeline reloaded = VK_NULL_HANDLE;
+		/// Bumped by each reload, so a slower, older rebuild is discarded.
+		uint32_t generation = 0;
+		/// A shader was reloaded while this was compiling, so it may have used
+		/// the old module and is rebuilt as soon as it is ready.
+		bool stale = false;
+	};
+
+	/// Replaced by a reload, destroyed once no frame in flight can use it.
+	struct Retired {
+		VkPipeline pipeline;
+		uint64_t frame;
+	};
+
+	/// Build the VkPipeline for 'desc' and publish it to its entry.
+	/// Called without 'mutex' held, from any thread.
+	void Compile(const imPipelineDesc &desc);
+	struct Shader {
+		VkShaderModule module;
+		imShaderReflection reflection;
+	};
+
+	/// Rebuild 'desc' after a reload and stage it in the entry's 'reloaded'.
+	void Rebuild(const imPipelineDesc &desc, uint32_t generation);
+	/// Build the VkPipeline for 'desc', bypassing the cache.
+	VkPipeline CreateGraphicsPipeline(const imPipelineDesc &desc);
+	/// Shader module and reflection for a SPIR-V file, loaded once and
+	/// shared by every pipeline. A reload replaces the pointer in 'shaders',
+	/// so compiles holding the old one keep reading it safely.
+	std::shared_ptr<const Shader> LoadShader(const std::string &file);
+
+	/// Guards 'pipelines', 'compiling' and the counters.
+	std::mutex mutex;
+	/// Signalled whenever a pipeline finishes compiling.
+	std::condition_variable compiled;
+	std::unordered_map<imPipelineDesc, Entry, imPipelineDescHash> pipelines;
+	/// Pipelines requested or being rebuilt, but not yet ready.
+	uint32_t compiling = 0;
+	/// Only touched by the main thread.
+	std::vector<Retired> retired;
 
+	/// Guards 'shaders', modules are loaded from the worker threads too.
+	std::mutex shaderMutex;
+	std::map<std::string, std::shared_ptr<const Shader>> shaders;
+	/// Modules replaced by a reload, destroyed once nothing is compiling.
+	std::vector<VkShaderModule> retiredModules;
 };
 
 #endif
@@ -0,0 +1,171 @@
+#include "imPipelineCache.h"
+
+#include <cstdio>
+
+imPipelineCache pipelineCache;
+
+/// Identifies our cache files, "IMPC".
+static const uint32_t CACHE_MAGIC = 0x43504d49;
+/// Bump whenever FileHeader changes.
+static const uint32_t CACHE_HEADER_VERSION = 1;
+
+void imPipelineCache::Create(const std::string &file) {
+	this->file = file;
+	std::vector<char> data = Load(file);
+	warm = !data.empty();
+
+	VkPipelineCacheCreateInfo cacheInfo = { };
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = data.size();
+	cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline cache!");
+	}
+
+	std::cout << "Pipeline cache " << file << ": ";
+	if (warm) {
+		std::cout << "loaded " << data.size() << " bytes." << std::endl;
+	} else {
+		std::cout << "starting cold, " << coldReason << "." << std::endl;
+	}
+	std::cout << "-----------------------------------------------" << std::endl;
+}
+
+VkResult imPipelineCache::CreateGraphicsPipelines(uint32_t count,
+		const VkGraphicsPipelineCreateInfo * createInfos, VkPipeline * pipelines) {
+	auto start = std::chrono::high_resolution_clock::now();
+	VkResult result = vkCreateGraphicsPipelines(device, cache, count, 
+		createInfos, nullptr, pipelines);
+	auto end = std::chrono::high_resolution_clock::now();
+
+	std::lock_guard<std::mutex> lock(statsMutex);
+	createTime += std::chrono::duration<double, std::milli>(end - start).count();
+	createCount += count;
+	return result;
+}
+
+VkResult imPipelineCache::CreateComputePipelines(uint32_t count,
+		const VkComputePipelineCreateInfo * createInfos, VkPipeline * pipelines) {
+	auto start = std::chrono::high_resolution_clock::now();
+	VkResult result = vkCreateComputePipelines(device, cache, count, 
+		createInfos, nullptr, pipelines);
+	auto end = std::chrono::high_resolution_clock::now();
+
+	std::lock_guard<std::mutex> lock(statsMutex);
+	createTime += std::chrono::duration<double, std::milli>(end - start).count();
+	createCount += count;
+	return result;
+}
+
+void imPipelineCache::PrintStats() {
+	std::cout << "Pipeline Cache (" << (warm ? "warm" : "cold") << "): "
+		<< createCount << " pipeline" << (createCount == 1 ? "" : "s")
+		<< " created in " << createTime << " ms" << std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
+}
+
+void imPipelineCache::Cleanup() {
+	Save(file);
+	vkDestroyPipelineCache(device, cache, nullptr);
+}
+
+imPipelineCache::FileHeader imPipelineCache::DeviceHeader() {
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(physicalDevice, &props);
+
+	FileHeader header = { };
+	header.magic = CACHE_MAGIC;
+	header.headerVersion = CACHE_HEADER_VERSION;
+	header.vendorID = props.vendorID;
+	header.deviceID = props.deviceID;
+	header.driverVersion = props.driverVersion;
+	memcpy(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+
+	return header;
+}
+
+std::vector<char> imPipelineCache::Load(const std::string &file) {
+	std::ifstream stream(file, std::ios::ate | std::ios::binary);
+	if (!stream.is_open()) {
+		coldReason = "no cache file";
+		return { };
+	}
+
+	size_t fileSize = (size_t)stream.tellg();
+	stream.seekg(0);
+
+	FileHeader header;
+	FileHeader expected = DeviceHeader();
+	if (fileSize < sizeof(header) ||
+			!stream.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+		coldReason = "cache file is truncated";
+		return { };
+	}
+
+	if (header.magic != expected.magic || header.headerVersion != expected.headerVersion) {
+		coldReason = "not a cache file";
+		return { };
+	}
+
+	if (header.vendorID != expected.vendorID || header.deviceID != expected.deviceID ||
+			memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+		coldReason = "cache was written by a different device";
+		return { };
+	}
+
+	if (header.driverVersion != expected.driverVersion) {
+		coldReason = "cache was written by a different driver version";
+		return { };
+	}
+
+	if (header.dataSize != fileSize - sizeof(header)) {
+		coldReason = "cache file is truncated";
+		return { };
+	}
+
+	std::vector<char> data(header.dataSize);
+	if (!stream.read(data.data(), data.size())) {
+		coldReason = "failed to read cache file";
+		return { };
+	}
+
+	return data;
+}
+
+void imPipelineCache::Save(const std::string &file) {
+	size_t dataSize = 0;
+	vkGetPipelineCacheData(device, cache, &dataSize, nullptr);
+	std::vector<char> data(dataSize);
+	if (vkGetPipelineCacheData(device, cache, &dataSize, data.data()) != VK_SUCCESS) {
+		std::cerr << "Failed to read pipeline cache data, not saving." << std::endl;
+		return;
+	}
+
+	FileHeader header = DeviceHeader();
+	header.dataSize = dataSize;
+
+	std::string temp = file + ".tmp";
+	{
+		std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+		stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		stream.write(data.data(), dataSize);
+
+		if (!stream) {
+			std::cerr << "Failed to write pipeline cache " << temp << std::endl;
+			stream.close();
+			std::remove(temp.c_str());
+			return;
+		}
+	}
+
+	// Rename replaces the old file in one step on POSIX file systems.
+	if (std::rename(temp.c_str(), file.c_str()) != 0) {
+		std::cerr << "Failed to replace pipeline cache " << file << std::endl;
+		std::remove(temp.c_str());
+		return;
+	}
+
+	std::cout << "Saved " << dataSize << " bytes to pipeline cache " << file << std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
+}
@@ -0,0 +1,73 @@
+#ifndef IM_PIPELINE_CACHE_H
+#define IM_PIPELINE_CACHE_H
+
+#include "imVulkan.h"
+
+#include <mutex>
+
+/// File the pipeline cache is kept in between runs.
+const std::string PIPELINE_CACHE_FILE = "pipeline.cache";
+
+/// VkPipelineCache shared by every pipeline the application creates, loaded from
+/// disk at startup and written back on shutdown. The file starts with a header
+/// identifying the device and driver that produced it, a cache from any other
+/// device or driver version is discarded rather than handed to the driver.
+class imPipelineCache {
+public:
+	/// Create the cache, seeded from 'file' if it holds a valid cache for this device.
+	void Create(const std::string &file = PIPELINE_CACHE_FILE);
+
+	/// vkCreateGraphicsPipelines against the shared cache, timed for PrintStats().
+	/// Both may be called from several threads at once, the driver
+	/// synchronizes access to the cache itself.
+	VkResult CreateGraphicsPipelines(uint32_t count,
+		const VkGraphicsPipelineCreateInfo * createInfos, VkPipeline * pipelines);
+	/// vkCreateComputePipelines against the shared cache, timed for PrintStats().
+	VkResult CreateComputePipelines(uint32_t count,
+		const VkComputePipelineCreateInfo * createInfos, VkPipeline * pipelines);
+
+	/// Print whether the cache started warm and how long pipeline creation took.
+	void PrintStats();
+
+	/// Write the cache back to disk and destroy it.
+	void Cleanup();
+
+	VkPipelineCache cache = VK_NULL_HANDLE;
+
+private:
+	/// Written ahead of the driver's own cache data.
+	struct FileHeader {
+		uint32_t magic;
+		uint32_t headerVersion;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+	};
+
+	/// Header describing the device we're running on.
+	FileHeader DeviceHeader();
+	/// Read 'file' and return the driver data, empty if missing or invalid.
+	std::vector<char> Load(const std::string &file);
+	/// Write to a temporary file and rename it over 'file', so an
+	/// interrupted write never leaves a truncated cache behind.
+	void Save(const std::string &file);
+
+	std::string file;
+	/// True if the cache was seeded from disk.
+	bool warm = false;
+	/// Why the file on disk was not used, if it wasn't.
+	std::string coldReason;
+
+	/// Guards the counters below.
+	std::mutex statsMutex;
+	/// Summed over every call, so exceeds wall time when compiling in parallel.
+	double createTime = 0.0;
+	uint32_t createCount = 0;
+};
+
+/// Global pipeline cache, every pipeline is created through it.
+extern imPipelineCache pipelineCache;
+
+#endif
@@ -0,0 +1,88 @@
+#include "imSamplerCache.h"
+#include "imDescriptorCache.h"
+
+imSamplerCache samplerCache;
+
+/// Bits of a float, so equal state compares equal without float compares.
+static uint32_t FloatBits(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+VkSampler imSamplerCache::Get(const VkSamplerCreateInfo &info) {
+	if (info.pNext != nullptr) {
+		throw std::runtime_error("Sampler cache does not support extension structures!");
+	}
+
+	Key key = { {
+		static_cast<uint32_t>(info.flags),
+		static_cast<uint32_t>(info.magFilter),
+		static_cast<uint32_t>(info.minFilter),
+		static_cast<uint32_t>(info.mipmapMode),
+		static_cast<uint32_t>(info.addressModeU),
+		static_cast<uint32_t>(info.addressModeV),
+		static_cast<uint32_t>(info.addressModeW),
+		FloatBits(info.mipLodBias),
+		static_cast<uint32_t>(info.anisotropyEnable),
+		FloatBits(info.maxAnisotropy),
+		static_cast<uint32_t>(info.compareEnable),
+		static_cast<uint32_t>(info.compareOp),
+		FloatBits(info.minLod),
+		FloatBits(info.maxLod),
+		static_cast<uint32_t>(info.borderColor),
+		static_cast<uint32_t>(info.unnormalizedCoordinates)
+	} };
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = samplers.find(key);
+	if (it != samplers.end()) {
+		it->second.references++;
+		hits++;
+		return it->second.sampler;
+	}
+
+	Entry entry;
+	entry.references = 1;
+	if (vkCreateSampler(device, &info, nullptr, &entry.sampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create texture sampler!");
+	}
+
+	misses++;
+	samplers[key] = entry;
+	keys[entry.sampler] = key;
+	return entry.sampler;
+}
+
+void imSamplerCache::Release(VkSampler sampler) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto key = keys.find(sampler);
+	if (key == keys.end()) {
+		throw std::runtime_error("Sampler was not created by the sampler cache!");
+	}
+
+	auto it = samplers.find(key->second);
+	if (--it->second.references > 0) {
+		return;
+	}
+
+	descriptorCache.Forget(sampler);
+	vkDestroySampler(device, sampler, nullptr);
+	samplers.erase(it);
+	keys.erase(key);
+}
+
+void imSamplerCache::PrintStats() {
+	std::cout << "Samplers: " << samplers.size() << " alive, " << hits << " shared, "
+		<< misses << " created" << std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
+}
+
+void imSamplerCache::Cleanup() {
+	for (auto &entry : samplers) {
+		vkDestroySampler(device, entry.second.sampler, nullptr);
+	}
+
+	samplers.clear();
+	keys.clear();
+}
@@ -0,0 +1,49 @@
+#ifndef IM_SAMPLER_CACHE_H
+#define IM_SAMPLER_CACHE_H
+
+#include "imVulkan.h"
+
+#include <mutex>
+#include <map>
+
+/// Shares one VkSampler between every user asking for the same state.
+/// Drivers cap the number of live samplers, often near 4000, while a scene
+/// rarely needs more than a handful of distinct ones. Samplers are reference
+/// counted, and destroyed once their last user releases them.
+class imSamplerCache {
+public:
+	/// Sampler matching every field of 'info', created on first use. Each
+	/// call takes a reference, to be returned with Release().
+	VkSampler Get(const VkSamplerCreateInfo &info);
+	/// Drop a reference taken by Get(), the device must be done with the
+	/// sampler if this is the last one.
+	void Release(VkSampler sampler);
+
+	/// Print how many samplers exist and how often they were shared.
+	void PrintStats();
+	/// Destroy every sampler, including any never released.
+	void Cleanup();
+
+	/// Requests served by an existing sampler.
+	uint32_t hits = 0;
+	/// Requests that created a new sampler.
+	uint32_t misses = 0;
+
+private:
+	/// Every field of VkSamplerCreateInfo after pNext, floats by their bits.
+	typedef std::array<uint32_t, 16> Key;
+
+	struct Entry {
+		VkSampler sampler;
+		uint32_t references;
+	};
+
+	std::mutex mutex;
+	std::map<Key, Entry> samplers;
+	std::map<VkSampler, Key> keys;
+};
+
+/// Global sampler cache, every texture takes its sampler from here.
+extern imSamplerCache samplerCache;
+
+#endif
@@ -0,0 +1,386 @@
+#include "imShaderReflection.h"
+
+#include <algorithm>
+
+// Values from the SPIR-V specification, only the ones we look at.
+
+static const uint32_t SPIRV_MAGIC = 0x07230203;
+static const uint32_t SPIRV_HEADER_WORDS = 5;
+
+static const uint32_t OP_ENTRY_POINT = 15;
+static const uint32_t OP_TYPE_INT = 21;
+static const uint32_t OP_TYPE_FLOAT = 22;
+static const uint32_t OP_TYPE_VECTOR = 23;
+static const uint32_t OP_TYPE_MATRIX = 24;
+static const uint32_t OP_TYPE_IMAGE = 25;
+static const uint32_t OP_TYPE_SAMPLER = 26;
+static const uint32_t OP_TYPE_SAMPLED_IMAGE = 27;
+static const uint32_t OP_TYPE_ARRAY = 28;
+static const uint32_t OP_TYPE_RUNTIME_ARRAY = 29;
+static const uint32_t OP_TYPE_STRUCT = 30;
+static const uint32_t OP_TYPE_POINTER = 32;
+static const uint32_t OP_CONSTANT = 43;
+static const uint32_t OP_VARIABLE = 59;
+static const uint32_t OP_DECORATE = 71;
+static const uint32_t OP_MEMBER_DECORATE = 72;
+
+static const uint32_t DECORATION_BUFFER_BLOCK = 3;
+static const uint32_t DECORATION_ARRAY_STRIDE = 6;
+static const uint32_t DECORATION_MATRIX_STRIDE = 7;
+static const uint32_t DECORATION_BUILT_IN = 11;
+static const uint32_t DECORATION_LOCATION = 30;
+static const uint32_t DECORATION_BINDING = 33;
+static const uint32_t DECORATION_DESCRIPTOR_SET = 34;
+static const uint32_t DECORATION_OFFSET = 35;
+
+static const uint32_t STORAGE_UNIFORM_CONSTANT = 0;
+static const uint32_t STORAGE_INPUT = 1;
+static const uint32_t STORAGE_UNIFORM = 2;
+static const uint32_t STORAGE_PUSH_CONSTANT = 9;
+static const uint32_t STORAGE_STORAGE_BUFFER = 12;
+
+static const uint32_t DIM_BUFFER = 5;
+static const uint32_t DIM_SUBPASS_DATA = 6;
+
+/// Execution models 0 through 5, vertex to compute.
+static const VkShaderStageFlagBits EXECUTION_STAGES[] = {
+	VK_SHADER_STAGE_VERTEX_BIT,
+	VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+	VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+	VK_SHADER_STAGE_GEOMETRY_BIT,
+	VK_SHADER_STAGE_FRAGMENT_BIT,
+	VK_SHADER_STAGE_COMPUTE_BIT
+};
+
+void imShaderReflection::Parse(const std::vector<char> &code) {
+	if (code.size() % 4 != 0 || code.size() < SPIRV_HEADER_WORDS * 4) {
+		throw std::runtime_error("Shader is not valid SPIR-V!");
+	}
+
+	std::vector<uint32_t> words(code.size() / 4);
+	memcpy(words.data(), code.data(), code.size());
+
+	if (words[0] != SPIRV_MAGIC) {
+		throw std::runtime_error("Shader is not valid SPIR-V!");
+	}
+
+	// Word 3 bounds every result id in the module.
+	ids.assign(words[3], Id());
+	bindings.clear();
+	inputs.clear();
+	pushConstantSize = 0;
+
+	bool foundEntryPoint = false;
+	std::vector<uint32_t> variables;
+
+	for (size_t i = SPIRV_HEADER_WORDS; i < words.size(); ) {
+		uint32_t opcode = words[i] & 0xFFFF;
+		uint32_t count = words[i] >> 16;
+		if (count == 0 || i + count > words.size()) {
+			throw std::runtime_error("Shader is not valid SPIR-V!");
+		}
+
+		const uint32_t * op = &words[i];
+		i += count;
+
+		switch (opcode) {
+		case OP_ENTRY_POINT:
+			if (!foundEntryPoint) {
+				if (op[1] >= sizeof(EXECUTION_STAGES) / sizeof(EXECUTION_STAGES[0])) {
+					throw std::runtime_error("Unsupported shader stage!");
+				}
+				stage = EXECUTION_STAGES[op[1]];
+				foundEntryPoint = true;
+			}
+			break;
+
+		case OP_DECORATE: {
+			if (count < 3) {
+				break;
+			}
+
+			Id &target = ids.at(op[1]);
+			uint32_t literal = count > 3 ? op[3] : 0;
+			switch (op[2]) {
+			case DECORATION_BUFFER_BLOCK: target.bufferBlock = true; break;
+			case DECORATION_ARRAY_STRIDE: target.arrayStride = literal; break;
+			case DECORATION_BUILT_IN: target.builtIn = true; break;
+			case DECORATION_LOCATION: target.location = literal; break;
+			case DECORATION_BINDING: target.binding = literal; break;
+			case DECORATION_DESCRIPTOR_SET: target.set = literal; break;
+			}
+			break;
+		}
+
+		case OP_MEMBER_DECORATE:
+			if (count < 5) {
+				break;
+			}
+
+			if (op[3] == DECORATION_OFFSET) {
+				ids.at(op[1]).memberOffsets[op[2]] = op[4];
+			} else if (op[3] == DECORATION_MATRIX_STRIDE) {
+				ids.at(op[1]).memberMatrixStrides[op[2]] = op[4];
+			}
+			break;
+
+		case OP_TYPE_INT:
+		case OP_TYPE_FLOAT:
+		case OP_TYPE_VECTOR:
+		case OP_TYPE_MATRIX:
+		case OP_TYPE_IMAGE:
+		case OP_TYPE_SAMPLER:
+		case OP_TYPE_SAMPLED_IMAGE:
+		case OP_TYPE_ARRAY:
+		case OP_TYPE_RUNTIME_ARRAY:
+		case OP_TYPE_STRUCT:
+		case OP_TYPE_POINTER: {
+			// Result id first, then the operands.
+			Id &type = ids.at(op[1]);
+			type.opcode = opcode;
+			type.operands.assign(op + 2, op + count);
+			break;
+		}
+
+		case OP_CONSTANT:
+		case OP_VARIABLE: {
+			// Result type first, then the result id and the operands.
+			Id &value = ids.at(op[2]);
+			value.opcode = opcode;
+			value.operands.assign(op + 3, op + count);
+			value.operands.insert(value.operands.begin(), op[1]);
+
+			if (opcode == OP_VARIABLE) {
+				variables.push_back(op[2]);
+			}
+			break;
+		}
+		}
+	}
+
+	if (!foundEntryPoint) {
+		throw std::runtime_error("Shader has no entry point!");
+	}
+
+	for (uint32_t id : variables) {
+		const Id &variable = Get(id);
+		uint32_t storageClass = variable.operands.at(1);
+		const Id &pointer = Get(variable.operands[0]);
+		uint32_t pointee = pointer.operands.at(1);
+
+		switch (storageClass) {
+		case STORAGE_UNIFORM_CONSTANT:
+		case STORAGE_UNIFORM:
+		case STORAGE_STORAGE_BUFFER: {
+			if (variable.binding == UINT32_MAX) {
+				break;
+			}
+
+			imReflectedBinding binding = { };
+			binding.set = variable.set == UINT32_MAX ? 0 : variable.set;
+			binding.binding = variable.binding;
+			binding.count = 1;
+
+			// Arrays of resources take one descriptor per element.
+			while (Get(pointee).opcode == OP_TYPE_ARRAY ||
+					Get(pointee).opcode == OP_TYPE_RUNTIME_ARRAY) {
+				const Id &array = Get(pointee);
+				binding.count = array.opcode == OP_TYPE_ARRAY
+					? binding.count * ConstantValue(array.operands.at(1)) : 0;
+				pointee = array.operands[0];
+			}
+
+			binding.type = DescriptorType(pointee, storageClass);
+			bindings.push_back(binding);
+			break;
+		}
+
+		case STORAGE_PUSH_CONSTANT:
+			pushConstantSize = std::max(pushConstantSize, TypeSize(pointee));
+			break;
+
+		case STORAGE_INPUT: {
+			if (stage != VK_SHADER_STAGE_VERTEX_BIT || variable.builtIn ||
+					variable.location == UINT32_MAX) {
+				break;
+			}
+
+			// A matrix takes one location per column.
+			const Id &type = Get(pointee);
+			uint32_t columns = 1;
+			uint32_t columnType = pointee;
+			if (type.opcode == OP_TYPE_MATRIX) {
+				columnType = type.operands.at(0);
+				columns = type.operands.at(1);
+			}
+
+			for (uint32_t c = 0; c < columns; c++) {
+				imReflectedInput input = { };
+				input.location = variable.location + c;
+				input.format = InputFormat(columnType);
+				inputs.push_back(input);
+			}
+			break;
+		}
+		}
+	}
+
+	std::sort(bindings.begin(), bindings.end(),
+		[](const imReflectedBinding &a, const imReflectedBinding &b) {
+			return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+		});
+	std::sort(inputs.begin(), inputs.end(),
+		[](const imReflectedInput &a, const imReflectedInput &b) {
+			return a.location < b.location;
+		});
+}
+
+bool imShaderReflection::SameInterface(const imShaderReflection &other) const {
+	auto sameBinding = [](const imReflectedBinding &a, const imReflectedBinding &b) {
+		return a.set == b.set && a.binding == b.binding && 
+			a.type == b.type && a.count == b.count;
+	};
+	auto sameInput = [](const imReflectedInput &a, const imReflectedInput &b) {
+		return a.location == b.location && a.format == b.format;
+	};
+
+	return stage == other.stage && pushConstantSize == other.pushConstantSize &&
+		bindings.size() == other.bindings.size() && inputs.size() == other.inputs.size() &&
+		std::equal(bindings.begin(), bindings.end(), other.bindings.begin(), sameBinding) &&
+		std::equal(inputs.begin(), inputs.end(), other.inputs.begin(), sameInput);
+}
+
+uint32_t imShaderReflection::TypeSize(uint32_t id, uint32_t matrixStride) const {
+	const Id &type = Get(id);
+
+	switch (type.opcode) {
+	case OP_TYPE_INT:
+	case OP_TYPE_FLOAT:
+		return type.operands.at(0) / 8;
+
+	case OP_TYPE_VECTOR:
+		return type.operands.at(1) * TypeSize(type.operands[0]);
+
+	case OP_TYPE_MATRIX: {
+		uint32_t stride = matrixStride ? matrixStride : TypeSize(type.operands.at(0));
+		return type.operands.at(1) * stride;
+	}
+
+	case OP_TYPE_ARRAY: {
+		uint32_t stride = type.arrayStride ? type.arrayStride
+			: TypeSize(type.operands.at(0));
+		return ConstantValue(type.operands.at(1)) * stride;
+	}
+
+	case OP_TYPE_STRUCT: {
+		// Members may be declared out of order, the block ends after the last one.
+		uint32_t size = 0;
+		for (uint32_t m = 0; m < type.operands.size(); m++) {
+			auto offset = type.memberOffsets.find(m);
+			auto stride = type.memberMatrixStrides.find(m);
+			uint32_t end = (offset == type.memberOffsets.end() ? 0 : offset->second) +
+				TypeSize(type.operands[m],
+					stride == type.memberMatrixStrides.end() ? 0 : stride->second);
+			size = std::max(size, end);
+		}
+		return size;
+	}
+	}
+
+	throw std::runtime_error("Unsupported type in shader block!");
+}
+
+VkDescriptorType imShaderReflection::DescriptorType(uint32_t id,
+		uint32_t storageClass) const {
+	const Id &type = Get(id);
+
+	switch (type.opcode) {
+	case OP_TYPE_SAMPLED_IMAGE:
+		return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+	case OP_TYPE_SAMPLER:
+		return VK_DESCRIPTOR_TYPE_SAMPLER;
+
+	case OP_TYPE_IMAGE: {
+		uint32_t dim = type.operands.at(1);
+		// 1 if used with a sampler, 2 if read and written as storage.
+		bool storage = type.operands.at(5) == 2;
+
+		if (dim == DIM_BUFFER) {
+			return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+				: VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+		}
+
+		if (dim == DIM_SUBPASS_DATA) {
+			return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+		}
+
+		return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+			: VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	}
+
+	case OP_TYPE_STRUCT:
+		// Older SPIR-V marks storage buffers as BufferBlock in the Uniform class.
+		if (storageClass == STORAGE_STORAGE_BUFFER || type.bufferBlock) {
+			return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		}
+		return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	}
+
+	throw std::runtime_error("Unsupported descriptor type in shader!");
+}
+
+VkFormat imShaderReflection::InputFormat(uint32_t id) const {
+	static const VkFormat FLOAT_FORMATS[] = {
+		VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+		VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT
+	};
+	static const VkFormat SINT_FORMATS[] = {
+		VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT,
+		VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT
+	};
+	static const VkFormat UINT_FORMATS[] = {
+		VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT,
+		VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT
+	};
+
+	const Id * scalar = &Get(id);
+	uint32_t components = 1;
+	if (scalar->opcode == OP_TYPE_VECTOR) {
+		components = scalar->operands.at(1);
+		scalar = &Get(scalar->operands[0]);
+	}
+
+	if (components < 1 || components > 4 || scalar->operands.empty() ||
+			scalar->operands[0] != 32) {
+		throw std::runtime_error("Unsupported vertex input type!");
+	}
+
+	if (scalar->opcode == OP_TYPE_FLOAT) {
+		return FLOAT_FORMATS[components - 1];
+	}
+
+	if (scalar->opcode == OP_TYPE_INT) {
+		bool isSigned = scalar->operands.at(1) != 0;
+		return isSigned ? SINT_FORMATS[components - 1] : UINT_FORMATS[components - 1];
+	}
+
+	throw std::runtime_error("Unsupported vertex input type!");
+}
+
+uint32_t imShaderReflection::ConstantValue(uint32_t id) const {
+	const Id &constant = Get(id);
+	if (constant.opcode != OP_CONSTANT || constant.operands.size() < 2) {
+		throw std::runtime_error("Shader array length is not a constant!");
+	}
+
+	return constant.operands[1];
+}
+
+const imShaderReflection::Id & imShaderReflection::Get(uint32_t id) const {
+	if (id >= ids.size()) {
+		throw std::runtime_error("Shader is not valid SPIR-V!");
+	}
+
+	return ids[id];
+}
@@ -0,0 +1,74 @@
+#ifndef IM_SHADER_REFLECTION_H
+#define IM_SHADER_REFLECTION_H
+
+#include "imVulkan.h"
+
+#include <map>
+
+/// Descriptor a shader expects at a particular set and binding.
+struct imReflectedBinding {
+	uint32_t set;
+	uint32_t binding;
+	VkDescriptorType type;
+	/// Array size, 0 for a runtime sized array.
+	uint32_t count;
+};
+
+/// Vertex attribute a shader reads, matrices take one entry per column.
+struct imReflectedInput {
+	uint32_t location;
+	VkFormat format;
+};
+
+/// Interface of a single SPIR-V module, found by walking its decorations,
+/// types and global variables. Only what we need to build pipeline
+/// layouts and vertex input state is kept.
+class imShaderReflection {
+public:
+	/// Parse the module in 'code', throws if it is not valid SPIR-V.
+	void Parse(const std::vector<char> &code);
+	/// True if 'other' has the same stage, bindings, push constants and inputs,
+	/// so it can replace this module without touching anything bound to it.
+	bool SameInterface(const imShaderReflection &other) const;
+
+	/// Stage of the module's first entry point.
+	VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+	/// Sorted by set, then binding.
+	std::vector<imReflectedBinding> bindings;
+	/// Size in bytes of the push constant block, 0 if there isn't one.
+	uint32_t pushConstantSize = 0;
+	/// Vertex stage inputs sorted by location, empty for any other stage.
+	std::vector<imReflectedInput> inputs;
+
+private:
+	/// What we track of each SPIR-V result id.
+	struct Id {
+		uint32_t opcode = 0;
+		/// Operands following the result id, for types and constants.
+		std::vector<uint32_t> operands;
+		uint32_t set = UINT32_MAX;
+		uint32_t binding = UINT32_MAX;
+		uint32_t location = UINT32_MAX;
+		uint32_t arrayStride = 0;
+		bool builtIn = false;
+		bool bufferBlock = false;
+		/// Struct member offsets and matrix strides, by member index.
+		std::map<uint32_t, uint32_t> memberOffsets;
+		std::map<uint32_t, uint32_t> memberMatrixStrides;
+	};
+
+	/// Size in bytes of type 'id' as laid out in a block.
+	uint32_t TypeSize(uint32_t id, uint32_t matrixStride = 0) const;
+	/// Descriptor type of a resource variable whose pointee is 'id'.
+	VkDescriptorType DescriptorType(uint32_t id, uint32_t storageClass) const;
+	/// Vertex format of a scalar or vector type.
+	VkFormat InputFormat(uint32_t id) const;
+	/// Literal value of the integer constant 'id'.
+	uint32_t ConstantValue(uint32_t id) const;
+	/// Entry for 'id', throws if out of range.
+	const Id & Get(uint32_t id) const;
+
+	std::vector<Id> ids;
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "imShaderWatcher.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+imShaderWatcher shaderWatcher;
+
+/// How long the watcher thread blocks before checking whether to stop.
+static const int WATCH_POLL_MS = 100;
+
+void imShaderWatcher::Start(const std::string &directory,
+		const std::map<std::string, std::string> &shaders) {
+	this->directory = directory;
+	this->shaders = shaders;
+
+#ifdef __linux__
+	// Editors either rewrite the file in place or rename a new one over it.
+	inotifyFd = inotify_init1(IN_CLOEXEC);
+	if (inotifyFd < 0 || inotify_add_watch(inotifyFd, directory.c_str(),
+			IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		// Only a development aid, so carry on without it.
+		std::cerr << "Failed to watch " << directory << ", shader hot reload is disabled."
+			<< std::endl;
+		Stop();
+		return;
+	}
+
+	stopping = false;
+	thread = std::thread(&imShaderWatcher::Watch, this);
+
+	std::cout << "Watching " << directory << " for shader changes." << std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
+#else
+	std::cerr << "Shader hot reload needs inotify, it is disabled on this platform."
+		<< std::endl;
+#endif
+}
+
+std::vector<std::string> imShaderWatcher::Changed() {
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<std::string> files;
+	files.swap(changed);
+	return files;
+}
+
+void imShaderWatcher::Stop() {
+	if (thread.joinable()) {
+		stopping = true;
+		thread.join();
+	}
+
+#ifdef __linux__
+	if (inotifyFd >= 0) {
+		close(inotifyFd);
+		inotifyFd = -1;
+	}
+#endif
+}
+
+void imShaderWatcher::Watch() {
+#ifdef __linux__
+	alignas(struct inotify_event) char buffer[4096];
+
+	while (!stopping) {
+		pollfd fd = { };
+		fd.fd = inotifyFd;
+		fd.events = POLLIN;
+		if (poll(&fd, 1, WATCH_POLL_MS) <= 0) {
+			continue;
+		}
+
+		ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+		if (length <= 0) {
+			continue;
+		}
+
+		// A save may produce several events for one file, compile it once.
+		std::set<std::string> modified;
+		for (char * p = buffer; p < buffer + length; ) {
+			const inotify_event * event = reinterpret_cast<const inotify_event *>(p);
+			if (event->len > 0) {
+				modified.insert(event->name);
+			}
+			p += sizeof(inotify_event) + event->len;
+		}
+
+		// Our own SPIR-V output lands here too, but isn't in 'shaders'.
+		for (const std::string &name : modified) {
+			auto it = shaders.find(name);
+			if (it == shaders.end()) {
+				continue;
+			}
+
+			std::string output = directory + "/" + it->second;
+			if (!Compile(directory + "/" + name, output)) {
+				continue;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (std::find(changed.begin(), changed.end(), output) == changed.end()) {
+				changed.push_back(output);
+			}
+		}
+	}
+#endif
+}
+
+bool imShaderWatcher::Compile(const std::string &source, const std::string &output) {
+	std::string temp = output + ".tmp";
+	std::string command = "glslangValidator -V \"" + source + "\" -o \"" + temp + "\"";
+
+	auto start = std::chrono::high_resolution_clock::now();
+	int status = std::system(command.c_str());
+	auto end = std::chrono::high_resolution_clock::now();
+
+	if (status != 0) {
+		std::cerr << "Failed to compile " << source << ", keeping the previous version."
+			<< std::endl;
+		std::remove(temp.c_str());
+		return false;
+	}
+
+	if (std::rename(temp.c_str(), output.c_str()) != 0) {
+		std::cerr << "Failed to replace " << output << std::endl;
+		std::remove(temp.c_str());
+		return false;
+	}
+
+	std::cout << "Recompiled " << source << " in "
+		<< std::chrono::duration<double, std::milli>(end - start).count()
+		<< " ms" << std::endl;
+	return true;
+}
@@ -0,0 +1,50 @@
+#ifndef IM_SHADER_WATCHER_H
+#define IM_SHADER_WATCHER_H
+
+#include "PREFIX.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <map>
+
+/// Watches a directory of GLSL sources with inotify and recompiles any that
+/// change to SPIR-V with glslangValidator, on a thread of its own. The
+/// render loop collects the rebuilt SPIR-V files through Changed() and
+/// reloads whatever uses them at its next frame boundary.
+class imShaderWatcher {
+public:
+	/// Watch 'directory', 'shaders' maps each GLSL file name within it to
+	/// the SPIR-V file it compiles to, as the makefile's glsl target does.
+	void Start(const std::string &directory,
+		const std::map<std::string, std::string> &shaders);
+
+	/// SPIR-V files rebuilt since the last call, each listed once.
+	std::vector<std::string> Changed();
+
+	/// Stop watching and join the watcher thread.
+	void Stop();
+
+private:
+	/// Watcher thread, waits for inotify events until Stop().
+	void Watch();
+	/// Compile 'source' to 'output' through a temporary file, so a failed
+	/// compile never replaces a good module. Returns true on success.
+	bool Compile(const std::string &source, const std::string &output);
+
+	std::string directory;
+	std::map<std::string, std::string> shaders;
+
+	int inotifyFd = -1;
+	std::thread thread;
+	std::atomic<bool> stopping { false };
+
+	std::mutex mutex;
+	/// Rebuilt SPIR-V files, in the order they finished.
+	std::vector<std::string> changed;
+};
+
+/// Global shader watcher, only started if SHADER_HOT_RELOAD_ENABLED.
+extern imShaderWatcher shaderWatcher;
+
+#endif
@@ -0,0 +1,535 @@
+#include "imStagingRing.h"
+#include "imBuffer.h"
+#include "imImage.h"
+
+imStagingRing stagingRing;
+
+/// Every read of uploaded data on the graphics queue happens in one of these.
+static const VkPipelineStageFlags UPLOAD_CONSUMER_STAGES =
+	VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+	VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+static const VkAccessFlags UPLOAD_CONSUMER_ACCESS =
+	VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+	VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+/// Create a resettable command pool for the given queue family.
+static VkCommandPool CreateUploadPool(uint32_t queueFamily) {
+	VkCommandPoolCreateInfo poolInfo = { };
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = queueFamily;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+		VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	VkCommandPool pool;
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create staging command pool!");
+	}
+
+	return pool;
+}
+
+/// Allocate a primary command buffer and an unsignalled fence to track it.
+static void CreateUploadCommands(VkCommandPool pool,
+		VkCommandBuffer &commandBuffer, VkFence &fence) {
+	VkCommandBufferAllocateInfo allocInfo = { };
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = pool;
+	allocInfo.commandBufferCount = 1;
+
+	if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate staging command buffer!");
+	}
+
+	VkFenceCreateInfo fenceInfo = { };
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create staging fence!");
+	}
+}
+
+void imStagingRing::Create(VkDeviceSize size) {
+	capacity = size;
+	CreateBuffer(capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		buffer, memory);
+
+	// Every write starts on an offset suitable for buffer -> image copies.
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(physicalDevice, &props);
+	alignment = std::max<VkDeviceSize>(alignment,
+		props.limits.optimalBufferCopyOffsetAlignment);
+
+	QueueFamilyIndices indices = FindQueueFamilies(physicalDevice, surface);
+	transferFamily = static_cast<uint32_t>(indices.transferFamily);
+	graphicsFamily = static_cast<uint32_t>(indices.graphicsFamily);
+	ownershipTransfer = transferFamily != graphicsFamily;
+
+	// Command buffers are recycled between batches, so they must be resettable.
+	pool = CreateUploadPool(transferFamily);
+	if (ownershipTransfer) {
+		acquirePool = CreateUploadPool(graphicsFamily);
+	}
+}
+
+void imStagingRing::UploadBuffer(VkBuffer dst, const void * data, VkDeviceSize size,
+		VkDeviceSize dstOffset) {
+	VkBuffer srcBuffer;
+	VkDeviceSize srcOffset;
+	void * mapped = Reserve(size, srcBuffer, srcOffset);
+	memcpy(mapped, data, static_cast<size_t>(size));
+
+	VkBufferCopy copyRegion = { };
+	copyRegion.srcOffset = srcOffset;
+	copyRegion.dstOffset = dstOffset;
+	copyRegion.size = size;
+	vkCmdCopyBuffer(Record(), srcBuffer, dst, 1, &copyRegion);
+
+	if (ownershipTransfer) {
+		VkBufferMemoryBarrier barrier = { };
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = transferFamily;
+		barrier.dstQueueFamilyIndex = graphicsFamily;
+		barrier.buffer = dst;
+		barrier.offset = dstOffset;
+		barrier.size = size;
+		recording.bufferBarriers.push_back(barrier);
+	}
+}
+
+void imStagingRing::UploadImage(VkImage dst, VkFormat format, uint32_t width,
+		uint32_t height, uint32_t mipLevels, const std::vector<imImageLevel> &levels) {
+	if (levels.empty() || levels.size() > mipLevels) {
+		throw std::runtime_error("Invalid mip levels for image upload!");
+	}
+
+	// One reservation for every level, so the whole image lands in one batch.
+	std::vector<VkDeviceSize> offsets(levels.size());
+	VkDeviceSize size = 0;
+	for (size_t level = 0; level < levels.size(); level++) {
+		offsets[level] = size;
+		size += (levels[level].size + alignment - 1) / alignment * alignment;
+	}
+
+	VkBuffer srcBuffer;
+	VkDeviceSize srcOffset;
+	char * mapped = static_cast<char *>(Reserve(size, srcBuffer, srcOffset));
+
+	std::vector<VkBufferImageCopy> regions(levels.size());
+	for (size_t level = 0; level < levels.size(); level++) {
+		memcpy(mapped + offsets[level], levels[level].data,
+			static_cast<size_t>(levels[level].size));
+
+		VkBufferImageCopy &region = regions[level];
+		region.bufferOffset = srcOffset + offsets[level];
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = static_cast<uint32_t>(level);
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { std::max(width >> level, 1u),
+			std::max(height >> level, 1u), 1 };
+	}
+
+	VkCommandBuffer commandBuffer = Record();
+	imImage::TransitionImageLayout(commandBuffer, dst, format,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, mipLevels);
+
+	vkCmdCopyBufferToImage(commandBuffer, srcBuffer, dst,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()), regions.data());
+
+	uint32_t firstLevel = static_cast<uint32_t>(levels.size());
+	bool blit = firstLevel < mipLevels;
+
+	if (!ownershipTransfer) {
+		if (blit) {
+			imImage::GenerateMipmaps(commandBuffer, dst, format, width, height,
+				firstLevel, mipLevels);
+		} else {
+			imImage::TransitionImageLayout(commandBuffer, dst, format,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, mipLevels);
+		}
+
+		return;
+	}
+
+	// The final layout transition happens as part of the ownership transfer,
+	// after the graphics queue has blitted any missing levels.
+	VkImageMemoryBarrier barrier = { };
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = blit ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+		: VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcQueueFamilyIndex = transferFamily;
+	barrier.dstQueueFamilyIndex = graphicsFamily;
+	barrier.image = dst;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	recording.imageBarriers.push_back(barrier);
+
+	if (blit) {
+		recording.mipChains.push_back({ dst, format, width, height, firstLevel, mipLevels });
+	}
+}
+
+imUploadToken imStagingRing::Flush(bool wait) {
+	if (recording.commandBuffer != VK_NULL_HANDLE) {
+		Batch &batch = recording;
+
+		if (ownershipTransfer) {
+			// Release every resource to the graphics queue family, transfer
+			// queues only understand transfer stages so the release ends there.
+			for (auto &barrier : batch.bufferBarriers) {
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = 0;
+			}
+
+			for (auto &barrier : batch.imageBarriers) {
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = 0;
+			}
+
+			vkCmdPipelineBarrier(batch.commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+				0, nullptr,
+				static_cast<uint32_t>(batch.bufferBarriers.size()),
+				batch.bufferBarriers.data(),
+				static_cast<uint32_t>(batch.imageBarriers.size()),
+				batch.imageBarriers.data());
+
+			RecordAcquire(batch);
+		} else {
+			// Make every buffer copy in this batch visible to any later draw.
+			VkMemoryBarrier barrier = { };
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = UPLOAD_CONSUMER_ACCESS;
+
+			vkCmdPipelineBarrier(batch.commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, UPLOAD_CONSUMER_STAGES,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record staging command buffer!");
+		}
+
+		VkSubmitInfo submitInfo = { };
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+		if (ownershipTransfer) {
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &batch.released;
+		}
+
+		if (vkQueueSubmit(transferQueue, 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit staging command buffer!");
+		}
+
+		batch.submitted = std::chrono::high_resolution_clock::now();
+		batch.token = ++lastToken;
+		batch.end = head;
+		inFlight.push_back(batch);
+		recording = Batch();
+		totalBatches++;
+	}
+
+	if (wait) {
+		Wait(lastToken);
+		while (Reclaim(true)) { }
+	} else {
+		Update();
+	}
+
+	return lastToken;
+}
+
+bool imStagingRing::IsComplete(imUploadToken token) {
+	Update();
+	return token <= completedToken;
+}
+
+void imStagingRing::Wait(imUploadToken token) {
+	for (auto &batch : inFlight) {
+		if (batch.token > token) { break; }
+		Complete(batch, true);
+	}
+}
+
+void imStagingRing::Update() {
+	for (auto &batch : inFlight) {
+		if (!Complete(batch, false)) { break; }
+	}
+
+	Reclaim(false);
+}
+
+void imStagingRing::PrintStats() {
+	double megabytes = totalBytes / (1024.0 * 1024.0);
+	std::cout << "Staging Ring: uploaded " << megabytes << " MiB in "
+		<< totalBatches << " batch" << (totalBatches == 1 ? "" : "es");
+	if (totalSeconds > 0.0) {
+		std::cout << " (" << megabytes / totalSeconds << " MiB/s)";
+	}
+
+	std::cout << std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
+}
+
+void imStagingRing::Cleanup() {
+	Flush(true);
+
+	for (auto &batch : freeBatches) {
+		vkDestroyFence(device, batch.fence, nullptr);
+		if (batch.acquireFence != VK_NULL_HANDLE) {
+			vkDestroyFence(device, batch.acquireFence, nullptr);
+			vkDestroySemaphore(device, batch.released, nullptr);
+		}
+	}
+
+	freeBatches.clear();
+	vkDestroyCommandPool(device, pool, nullptr);
+	if (acquirePool != VK_NULL_HANDLE) {
+		vkDestroyCommandPool(device, acquirePool, nullptr);
+	}
+
+	DestroyBuffer(buffer, memory);
+}
+
+void * imStagingRing::Reserve(VkDeviceSize size, VkBuffer &srcBuffer,
+		VkDeviceSize &srcOffset) {
+	// Too big to ever fit, give it a buffer of its own for this batch only.
+	if (size > capacity) {
+		std::pair<VkBuffer, imAllocation> overflow;
+		CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			overflow.first, overflow.second);
+		recording.overflow.push_back(overflow);
+		recording.bytes += size;
+
+		srcBuffer = overflow.first;
+		srcOffset = 0;
+		return overflow.second.mapped;
+	}
+
+	VkDeviceSize position;
+	while (true) {
+		// Nothing outstanding, so everything behind the head is free.
+		bool idle = inFlight.empty() && recording.commandBuffer == VK_NULL_HANDLE;
+		if (idle) { tail = head; }
+
+		position = (head + alignment - 1) / alignment * alignment;
+		VkDeviceSize offset = position % capacity;
+
+		// Regions never wrap, skip to the start of the ring instead.
+		if (offset + size > capacity) {
+			position += capacity - offset;
+		}
+
+		if (idle) { tail = position; }
+		if (position + size - tail <= capacity) { break; }
+
+		// The ring is full, submit what we have and wait for the oldest batch.
+		if (recording.commandBuffer != VK_NULL_HANDLE) {
+			Flush(false);
+		}
+
+		Reclaim(true);
+	}
+
+	head = position + size;
+	recording.bytes += size;
+
+	srcBuffer = buffer;
+	srcOffset = position % capacity;
+	return static_cast<char *>(memory.mapped) + srcOffset;
+}
+
+VkCommandBuffer imStagingRing::Record() {
+	if (recording.commandBuffer != VK_NULL_HANDLE) {
+		return recording.commandBuffer;
+	}
+
+	// Keep any overflow buffers or byte counts already reserved for this batch.
+	Batch batch = recording;
+	if (!freeBatches.empty()) {
+		const Batch &recycled = freeBatches.back();
+		batch.commandBuffer = recycled.commandBuffer;
+		batch.fence = recycled.fence;
+		batch.acquireBuffer = recycled.acquireBuffer;
+		batch.acquireFence = recycled.acquireFence;
+		batch.released = recycled.released;
+		freeBatches.pop_back();
+	} else {
+		CreateUploadCommands(pool, batch.commandBuffer, batch.fence);
+
+		if (ownershipTransfer) {
+			CreateUploadCommands(acquirePool, batch.acquireBuffer, batch.acquireFence);
+
+			VkSemaphoreCreateInfo semaphoreInfo = { };
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &batch.released)
+					!= VK_SUCCESS) {
+				throw std::runtime_error("Failed to create staging semaphore!");
+			}
+		}
+	}
+
+	VkCommandBufferBeginInfo beginInfo = { };
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+	recording = batch;
+	return recording.commandBuffer;
+}
+
+void imStagingRing::RecordAcquire(Batch &batch) {
+	std::vector<VkBufferMemoryBarrier> bufferBarriers = batch.bufferBarriers;
+	std::vector<VkImageMemoryBarrier> imageBarriers = batch.imageBarriers;
+
+	for (auto &barrier : bufferBarriers) {
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = UPLOAD_CONSUMER_ACCESS;
+	}
+
+	VkPipelineStageFlags dstStages = UPLOAD_CONSUMER_STAGES;
+	for (auto &barrier : imageBarriers) {
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		// Still to be blitted into its remaining mip levels.
+		if (barrier.newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT |
+				VK_ACCESS_TRANSFER_WRITE_BIT;
+			dstStages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+		}
+	}
+
+	VkCommandBufferBeginInfo beginInfo = { };
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(batch.acquireBuffer, &beginInfo);
+
+	vkCmdPipelineBarrier(batch.acquireBuffer,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages, 0,
+		0, nullptr,
+		static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+		static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+
+	for (const MipChain &chain : batch.mipChains) {
+		imImage::GenerateMipmaps(batch.acquireBuffer, chain.image, chain.format,
+			chain.width, chain.height, chain.firstLevel, chain.mipLevels);
+	}
+
+	if (vkEndCommandBuffer(batch.acquireBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to record acquire command buffer!");
+	}
+}
+
+bool imStagingRing::Complete(Batch &batch, bool wait) {
+	if (batch.complete) { return true; }
+
+	if (wait) {
+		vkWaitForFences(device, 1, &batch.fence, VK_TRUE,
+			std::numeric_limits<uint64_t>::max());
+	} else if (vkGetFenceStatus(device, batch.fence) != VK_SUCCESS) {
+		return false;
+	}
+
+	// The transfer has already finished, so waiting on its semaphore here
+	// costs the graphics queue nothing.
+	if (ownershipTransfer) {
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		VkSubmitInfo submitInfo = { };
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &batch.released;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.acquireBuffer;
+
+		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, batch.acquireFence)
+				!= VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit acquire command buffer!");
+		}
+	}
+
+	// Time runs from each submit to its fence, counting the spans of batches
+	// in flight together only once. Fences are polled once a frame, which
+	// bounds how late a completion is seen.
+	auto now = std::chrono::high_resolution_clock::now();
+	auto start = std::max(batch.submitted, busyUntil);
+	if (now > start) {
+		totalSeconds += std::chrono::duration<double, std::chrono::seconds::period>(
+			now - start).count();
+	}
+
+	busyUntil = std::max(busyUntil, now);
+	totalBytes += batch.bytes;
+
+	batch.complete = true;
+	completedToken = std::max(completedToken, batch.token);
+	return true;
+}
+
+bool imStagingRing::Reclaim(bool wait) {
+	bool retired = false;
+
+	while (!inFlight.empty()) {
+		Batch &batch = inFlight.front();
+		bool block = wait && !retired;
+
+		if (!Complete(batch, block)) { break; }
+
+		if (batch.acquireFence != VK_NULL_HANDLE) {
+			if (block) {
+				vkWaitForFences(device, 1, &batch.acquireFence, VK_TRUE,
+					std::numeric_limits<uint64_t>::max());
+			} else if (vkGetFenceStatus(device, batch.acquireFence) != VK_SUCCESS) {
+				break;
+			}
+		}
+
+		Retire(batch);
+		inFlight.pop_front();
+		retired = true;
+	}
+
+	return retired;
+}
+
+void imStagingRing::Retire(Batch &batch) {
+	for (auto &overflow : batch.overflow) {
+		DestroyBuffer(overflow.first, overflow.second);
+	}
+
+	tail = std::max(tail, batch.end);
+
+	vkResetFences(device, 1, &batch.fence);
+	vkResetCommandBuffer(batch.commandBuffer, 0);
+	if (batch.acquireFence != VK_NULL_HANDLE) {
+		vkResetFences(device, 1, &batch.acquireFence);
+		vkResetCommandBuffer(batch.acquireBuffer, 0);
+	}
+
+	Batch recycled;
+	recycled.commandBuffer = batch.commandBuffer;
+	recycled.fence = batch.fence;
+	recycled.acquireBuffer = batch.acquireBuffer;
+	recycled.acquireFence = batch.acquireFence;
+	recycled.released = batch.released;
+	freeBatches.push_back(recycled);
+}
@@ -0,0 +1,158 @@
+#ifndef IM_STAGING_RING_H
+#define IM_STAGING_RING_H
+
+#include "imVulkan.h"
+#include "imAllocator.h"
+
+#include <deque>
+
+/// Default capacity of the persistently mapped staging ring.
+const VkDeviceSize IM_STAGING_RING_SIZE = 32 * 1024 * 1024;
+
+/// Identifies a flushed batch of uploads, see imStagingRing::IsComplete.
+typedef uint64_t imUploadToken;
+
+/// Tightly packed texels of one mip level, see imStagingRing::UploadImage.
+struct imImageLevel {
+	const void * data;
+	VkDeviceSize size;
+};
+
+/// Persistently mapped upload buffer shared by every transfer to device local memory.
+/// Uploads are copied into the ring immediately and their transfer commands are
+/// recorded into a single command buffer, which is submitted on Flush().
+/// Space in the ring is reclaimed once the fence of the batch that used it signals.
+///
+/// Batches run on the transfer queue. When that is a dedicated queue family,
+/// every uploaded resource is released by the transfer queue and acquired by the
+/// graphics queue once the batch has finished, so rendering never waits on uploads.
+class imStagingRing {
+public:
+	/// Create the ring buffer and the command pools used to record uploads.
+	void Create(VkDeviceSize size = IM_STAGING_RING_SIZE);
+
+	/// Copy 'size' bytes of 'data' into 'dst' at 'dstOffset'.
+	void UploadBuffer(VkBuffer dst, const void * data, VkDeviceSize size,
+		VkDeviceSize dstOffset = 0);
+
+	/// Copy 'levels' into the first mip levels of 'dst', transitioning all
+	/// 'mipLevels' of it from VK_IMAGE_LAYOUT_UNDEFINED to
+	/// VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. Levels not given are blitted
+	/// from the last one that was, 'dst' must then support linear blits.
+	void UploadImage(VkImage dst, VkFormat format, uint32_t width, uint32_t height,
+		uint32_t mipLevels, const std::vector<imImageLevel> &levels);
+
+	/// Submit every upload recorded since the last flush as one batch.
+	/// If 'wait' is true, block until the GPU has consumed the whole ring.
+	/// Returns a token for the submitted batch.
+	imUploadToken Flush(bool wait = false);
+
+	/// True once the batch has finished and its resources may be used for rendering.
+	bool IsComplete(imUploadToken token);
+	/// Block until the batch has finished and its resources may be used for rendering.
+	void Wait(imUploadToken token);
+
+	/// Poll in flight batches, hand finished resources to the graphics queue
+	/// and recycle their ring space. Call once per frame.
+	void Update();
+
+	/// Print the total amount of data uploaded and the achieved throughput.
+	void PrintStats();
+
+	/// Wait for all pending batches and release the ring.
+	void Cleanup();
+
+private:
+	/// Arguments to imImage::GenerateMipmaps for an uploaded image.
+	struct MipChain {
+		VkImage image;
+		VkFormat format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t firstLevel;
+		uint32_t mipLevels;
+	};
+
+	/// A batch of uploads that has been submitted but not necessarily consumed.
+	struct Batch {
+		imUploadToken token = 0;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+
+		/// Only used with a dedicated transfer queue, acquires ownership
+		/// of every resource in this batch on the graphics queue.
+		VkCommandBuffer acquireBuffer = VK_NULL_HANDLE;
+		VkFence acquireFence = VK_NULL_HANDLE;
+		VkSemaphore released = VK_NULL_HANDLE;
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		/// Images whose remaining mip levels are blitted once acquired,
+		/// transfer queues may not support blits.
+		std::vector<MipChain> mipChains;
+
+		/// Set once the transfer has finished and ownership has been acquired.
+		bool complete = false;
+
+		/// Ring position one past the last byte written by this batch.
+		VkDeviceSize end = 0;
+		VkDeviceSize bytes = 0;
+		/// When the batch was handed to the transfer queue.
+		std::chrono::high_resolution_clock::time_point submitted;
+		/// Uploads too large for the ring get a buffer of their own,
+		/// which is released alongside the batch.
+		std::vector<std::pair<VkBuffer, imAllocation>> overflow;
+	};
+
+	/// Reserve 'size' bytes of the ring, returns a pointer to write to
+	/// and the offset of that region within 'buffer'.
+	void * Reserve(VkDeviceSize size, VkBuffer &srcBuffer, VkDeviceSize &srcOffset);
+	/// Command buffer of the batch currently being recorded.
+	VkCommandBuffer Record();
+	/// Record the graphics queue half of every ownership transfer in 'batch'.
+	void RecordAcquire(Batch &batch);
+	/// Check (or wait for) the batch's transfer, then submit its acquire.
+	bool Complete(Batch &batch, bool wait);
+	/// Retire finished batches, or wait for and retire the oldest one if 'wait'.
+	bool Reclaim(bool wait);
+	void Retire(Batch &batch);
+
+	VkBuffer buffer = VK_NULL_HANDLE;
+	imAllocation memory;
+	VkDeviceSize capacity = 0;
+	VkDeviceSize alignment = 16;
+
+	/// Monotonic write/read positions, the ring offset is position % capacity.
+	VkDeviceSize head = 0;
+	VkDeviceSize tail = 0;
+
+	/// True when uploads run on a different queue family than rendering.
+	bool ownershipTransfer = false;
+	uint32_t transferFamily = 0;
+	uint32_t graphicsFamily = 0;
+
+	/// Pool for the transfer queue, and for acquires on the graphics queue.
+	VkCommandPool pool = VK_NULL_HANDLE;
+	VkCommandPool acquirePool = VK_NULL_HANDLE;
+	/// Batch being recorded, its command buffer is null until the first upload.
+	Batch recording;
+	/// Submitted batches, oldest first.
+	std::deque<Batch> inFlight;
+	/// Retired command buffers and sync objects, ready to record another batch.
+	std::vector<Batch> freeBatches;
+
+	imUploadToken lastToken = 0;
+	imUploadToken completedToken = 0;
+
+	uint64_t totalBytes = 0;
+	uint64_t totalBatches = 0;
+	/// Wall-clock time the transfer queue had uploads in flight.
+	double totalSeconds = 0.0;
+	/// Completion time of the latest finished batch, where the next busy span
+	/// starts at the earliest.
+	std::chrono::high_resolution_clock::time_point busyUntil;
+};
+
+/// Global staging ring used by meshes and images.
+extern imStagingRing stagingRing;
+
+#endif
@@ -64,9 +64,9 @@ void imSwapChain::CreateSwapChain() {
 	// if we're running in windowed mode.
 	// We'll just take the better performance for now.
 	createInfo.clipped = VK_TRUE;
-	// If window is resized, we'll need to create a new swap chain.
-	// We'll learn more about this later.
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	// Hand over the swap chain we are replacing (if any), which lets the
+	// driver reuse its resources and finish presenting what it had queued.
+	createInfo.oldSwapchain = swapChain;
 
 	// Finally! We're reading to create the swap chain!
 	if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) 
@@ -84,20 +84,73 @@ void imSwapChain::CreateSwapChain() {
 	imageFormat = format.format;
 }
 
+void imSwapChain::Recreate(VkRenderPass &renderPass, uint64_t frameNumber) {
+	// The retired swap chain stays valid until destroyed, CreateSwapChain
+	// reads it from 'swapChain' before overwriting it.
+	Retire(frameNumber);
+	CreateSwapChain();
+	CreateImageViews();
+	CreateDepthBuffer();
+	CreateFrameBuffers(renderPass);
+}
+
+VkFormat imSwapChain::QuerySurfaceFormat() {
+	SwapChainSupportDetails details = QuerySwapChainSupport(physicalDevice);
+	return ChooseSwapSurfaceFormat(details.formats).format;
+}
+
+void imSwapChain::ReleaseRetired(uint64_t frameNumber) {
+	// Called once the fence of frame 'frameNumber - MAX_FRAMES_IN_FLIGHT' has
+	// signalled, so every frame recorded before the swap has finished by
+	// 'frame + MAX_FRAMES_IN_FLIGHT - 1'. One more frame allows for presentation,
+	// which no fence tracks.
+	while (!retired.empty() && 
+			frameNumber >= retired.front().frame + MAX_FRAMES_IN_FLIGHT) {
+		Destroy(retired.front());
+		retired.erase(retired.begin());
+	}
+}
+
 void imSwapChain::Cleanup() {
-	vkDestroyImageView(device, depthImageView, nullptr);
-	vkDestroyImage(device, depthImage, nullptr);
-	vkFreeMemory(device, depthImageMemory, nullptr);
+	Retire(0);
 
-	for (size_t i = 0; i < frameBuffers.size(); i++) {
-		vkDestroyFramebuffer(device, frameBuffers[i], nullptr);
+	for (auto &old : retired) {
+		Destroy(old);
 	}
 
-	for (size_t i = 0; i < imageViews.size(); i++) {
-		vkDestroyImageView(device, imageViews[i], nullptr);
+	retired.clear();
+	swapChain = VK_NULL_HANDLE;
+}
+
+void imSwapChain::Retire(uint64_t frameNumber) {
+	Retired old;
+	old.swapChain = swapChain;
+	old.imageViews = imageViews;
+	old.frameBuffers = frameBuffers;
+	old.depthImage = depthImage;
+	old.depthImageMemory = depthImageMemory;
+	old.depthImageView = depthImageView;
+	old.frame = frameNumber;
+	retired.push_back(old);
+
+	imageViews.clear();
+	frameBuffers.clear();
+}
+
+void imSwapChain::Destroy(Retired &old) {
+	vkDestroyImageView(device, old.depthImageView, nullptr);
+	vkDestroyImage(device, old.depthImage, nullptr);
+	allocator.Free(old.depthImageMemory);
+
+	for (size_t i = 0; i < old.frameBuffers.size(); i++) {
+		vkDestroyFramebuffer(device, old.frameBuffers[i], nullptr);
+	}
+
+	for (size_t i = 0; i < old.imageViews.size(); i++) {
+		vkDestroyImageView(device, old.imageViews[i], nullptr);
 	}
 	
-	vkDestroySwapchainKHR(device, swapChain, nullptr);
+	vkDestroySwapchainKHR(device, old.swapChain, nullptr);
 }
 
 VkSurfaceFormatKHR imSwapChain::ChooseSwapSurfaceFormat(
@@ -107,12 +160,13 @@ VkSurfaceFormatKHR imSwapChain::ChooseSwapSurfaceFormat(
 	if (availableFormats.size() == 1 && 
 			availableFormats[0].format == VK_FORMAT_UNDEFINED) {
 		std::cout << "Format undefined, creating preferred format." << std::endl;
-		return { VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+		return { VK_FORMAT_B8G8R8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
 	}
 	
 	// Not best case scenario, but maybe what we want is present anyway.
+	// Shaders output linear color, sampled from sRGB textures.
 	for (const auto &f : availableFormats) {
-		if (f.format == VK_FORMAT_B8G8R8A8_UNORM 
+		if (f.format == VK_FORMAT_B8G8R8A8_SRGB 
 				&& f.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
 			// Cool beans, we got it. :)
 			std::cout << "Preferred format selected manually." << std::endl;
@@ -155,12 +209,12 @@ VkExtent2D imSwapChain::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabil
 	// Clamp the actual screen  width/height to the min/max supported values.
 	actualExtent.width = std::max(
 		capabilities.minImageExtent.width,
-		std::max(capabilities.maxImageExtent.width, actualExtent.width)
+		std::min(capabilities.maxImageExtent.width, actualExtent.width)
 	);
 
 	actualExtent.height = std::max(
 		capabilities.minImageExtent.height,
-		std::max(capabilities.maxImageExtent.height, actualExtent.height)
+		std::min(capabilities.maxImageExtent.height, actualExtent.height)
 	);
 
 	return actualExtent;
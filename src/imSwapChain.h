@@ -20,7 +20,21 @@ public:
 	/// Create and allocate the depth buffer.
 	void CreateDepthBuffer();
 
-	/// Cleanup data stored by the swap chain.
+	/// Replace the swap chain and everything sized to it (image views, depth
+	/// buffer and frame buffers) after a resize, handing the old swap chain over
+	/// as 'oldSwapchain'. The old objects are retired rather than destroyed,
+	/// since frames still in flight may reference them. 'frameNumber' is the
+	/// number of frames submitted so far.
+	void Recreate(VkRenderPass &renderPass, uint64_t frameNumber);
+
+	/// Format the next CreateSwapChain() or Recreate() will pick, so anything
+	/// built against the image format can be replaced beforehand.
+	VkFormat QuerySurfaceFormat();
+
+	/// Destroy retired objects that no frame in flight can still reference.
+	void ReleaseRetired(uint64_t frameNumber);
+
+	/// Cleanup data stored by the swap chain, including anything retired.
 	void Cleanup();
 
 	// -----------------------------------
@@ -28,7 +42,7 @@ public:
 	// -----------------------------------
 
 	/// Holds all of our render targets, we'll be aiming for tripple buffering.
-	VkSwapchainKHR swapChain;
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
 
 	/// Image format that was used to create the swap chain, useful to keep around.
 	VkFormat imageFormat;
@@ -38,7 +52,7 @@ public:
 	/// Image to use for the depth buffer, we only need one.
 	VkImage depthImage;
 	/// Use to allocate and free memory for the depth buffer.
-	VkDeviceMemory depthImageMemory;
+	imAllocation depthImageMemory;
 	/// View into the depth buffer.
 	VkImageView depthImageView;
 
@@ -52,6 +66,24 @@ public:
 	std::vector<VkFramebuffer> frameBuffers;
 
 private:
+	/// Size dependent objects replaced by Recreate().
+	struct Retired {
+		VkSwapchainKHR swapChain;
+		std::vector<VkImageView> imageViews;
+		std::vector<VkFramebuffer> frameBuffers;
+		VkImage depthImage;
+		imAllocation depthImageMemory;
+		VkImageView depthImageView;
+		/// Frame number when these were replaced.
+		uint64_t frame;
+	};
+
+	/// Move the current size dependent objects to the retired list.
+	void Retire(uint64_t frameNumber);
+	void Destroy(Retired &old);
+
+	std::vector<Retired> retired;
+
 	// -------------------------------------------------
 	// --- Private Utilities for Swap Chain Creation ---
 	// -------------------------------------------------
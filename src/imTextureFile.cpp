@@ -0,0 +1,380 @@
+#include "imTextureFile.h"
+#include "imMipChain.h"
+
+#include <algorithm>
+
+/// First bytes of every KTX2 file.
+static const uint8_t KTX2_IDENTIFIER[12] = {
+	0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+/// Identifier, nine header fields and the data format, key/value and
+/// supercompression indices, after which the level index starts.
+static const size_t KTX2_LEVEL_INDEX = 80;
+
+/// Sizes of the DDS magic number, its header, and the DX10 extension.
+static const size_t DDS_MAGIC_SIZE = 4;
+static const size_t DDS_HEADER_SIZE = 124;
+static const size_t DDS_DX10_SIZE = 20;
+static const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+static const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+static const uint32_t DDSCAPS2_VOLUME = 0x200000;
+
+/// DXGI_FORMAT values of the block formats DX10 headers may name.
+enum {
+	DXGI_FORMAT_BC1_UNORM = 71,
+	DXGI_FORMAT_BC1_UNORM_SRGB = 72,
+	DXGI_FORMAT_BC3_UNORM = 77,
+	DXGI_FORMAT_BC3_UNORM_SRGB = 78,
+	DXGI_FORMAT_BC5_UNORM = 83,
+	DXGI_FORMAT_BC5_SNORM = 84,
+	DXGI_FORMAT_BC7_UNORM = 98,
+	DXGI_FORMAT_BC7_UNORM_SRGB = 99
+};
+
+/// Little endian integer at 'offset', both containers store them this way.
+template <typename T>
+static T ReadValue(const std::vector<uint8_t> &file, size_t offset) {
+	T value = 0;
+	for (size_t i = 0; i < sizeof(T); i++) {
+		value |= static_cast<T>(file[offset + i]) << (8 * i);
+	}
+
+	return value;
+}
+
+static uint32_t FourCC(const char * code) {
+	return static_cast<uint32_t>(code[0]) | static_cast<uint32_t>(code[1]) << 8 |
+		static_cast<uint32_t>(code[2]) << 16 | static_cast<uint32_t>(code[3]) << 24;
+}
+
+/// KHR data format descriptor values written by Save().
+static const uint32_t KHR_DF_MODEL_RGBSDA = 1;
+static const uint32_t KHR_DF_MODEL_BC1A = 128;
+static const uint32_t KHR_DF_MODEL_BC3 = 130;
+static const uint32_t KHR_DF_MODEL_BC5 = 132;
+static const uint32_t KHR_DF_MODEL_BC7 = 134;
+static const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+static const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+static const uint32_t KHR_DF_TRANSFER_SRGB = 2;
+static const uint32_t KHR_DF_SAMPLE_SIGNED = 0x40;
+static const uint32_t KHR_DF_SAMPLE_LINEAR = 0x10;
+
+/// Layout of a format the loader takes, 'bytes' is 0 for any other.
+struct imBlockInfo {
+	/// Texels along each side of a block, 1 for uncompressed formats.
+	uint32_t dimension;
+	VkDeviceSize bytes;
+	uint32_t model;
+	bool srgb;
+};
+
+static imBlockInfo BlockInfo(VkFormat format) {
+	switch (format) {
+		case VK_FORMAT_R8G8B8A8_UNORM: return { 1, 4, KHR_DF_MODEL_RGBSDA, false };
+		case VK_FORMAT_R8G8B8A8_SRGB: return { 1, 4, KHR_DF_MODEL_RGBSDA, true };
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: return { 4, 8, KHR_DF_MODEL_BC1A, false };
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK: return { 4, 8, KHR_DF_MODEL_BC1A, true };
+		case VK_FORMAT_BC3_UNORM_BLOCK: return { 4, 16, KHR_DF_MODEL_BC3, false };
+		case VK_FORMAT_BC3_SRGB_BLOCK: return { 4, 16, KHR_DF_MODEL_BC3, true };
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK: return { 4, 16, KHR_DF_MODEL_BC5, false };
+		case VK_FORMAT_BC7_UNORM_BLOCK: return { 4, 16, KHR_DF_MODEL_BC7, false };
+		case VK_FORMAT_BC7_SRGB_BLOCK: return { 4, 16, KHR_DF_MODEL_BC7, true };
+		default: return { 1, 0, 0, false };
+	}
+}
+
+/// Samples of the basic data format descriptor, four words each.
+static std::vector<uint32_t> DescriptorSamples(VkFormat format) {
+	imBlockInfo info = BlockInfo(format);
+	std::vector<uint32_t> samples;
+
+	if (info.model == KHR_DF_MODEL_RGBSDA) {
+		// R, G, B then A, whose channel id is 15. Alpha is never sRGB encoded.
+		const uint32_t channels[] = { 0, 1, 2, 15 };
+		for (uint32_t i = 0; i < 4; i++) {
+			uint32_t qualifiers = (info.srgb && i == 3) ? KHR_DF_SAMPLE_LINEAR : 0;
+			samples.insert(samples.end(), {
+				i * 8 | 7 << 16 | (channels[i] | qualifiers) << 24, 0, 0, 255 });
+		}
+	} else if (format == VK_FORMAT_BC5_UNORM_BLOCK || format == VK_FORMAT_BC5_SNORM_BLOCK) {
+		// Red and green, each a 64 bit half of the block.
+		uint32_t qualifiers = format == VK_FORMAT_BC5_SNORM_BLOCK ? KHR_DF_SAMPLE_SIGNED : 0;
+		uint32_t lower = qualifiers ? 0x80000000u : 0;
+		uint32_t upper = qualifiers ? 0x7FFFFFFFu : 0xFFFFFFFFu;
+		samples.insert(samples.end(), { 0 | 63 << 16 | qualifiers << 24, 0, lower, upper });
+		samples.insert(samples.end(), { 64 | 63 << 16 | (1 | qualifiers) << 24, 0, lower, upper });
+	} else if (info.model == KHR_DF_MODEL_BC3) {
+		// Alpha in the first half, color in the second.
+		samples.insert(samples.end(), { 0 | 63 << 16 | 15u << 24, 0, 0, 0xFFFFFFFFu });
+		samples.insert(samples.end(), { 64 | 63 << 16, 0, 0, 0xFFFFFFFFu });
+	} else {
+		// BC1 and BC7 blocks are a single sample, BC1 with alpha is channel 1.
+		bool alpha = format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK ||
+			format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+		uint32_t bits = static_cast<uint32_t>(info.bytes * 8 - 1);
+		samples.insert(samples.end(), { bits << 16 | (alpha ? 1u : 0u) << 24,
+			0, 0, 0xFFFFFFFFu });
+	}
+
+	return samples;
+}
+
+/// Basic data format descriptor of 'format', including its total size.
+static std::vector<uint32_t> DataFormatDescriptor(VkFormat format) {
+	imBlockInfo info = BlockInfo(format);
+	std::vector<uint32_t> samples = DescriptorSamples(format);
+	uint32_t blockSize = static_cast<uint32_t>(24 + samples.size() * 4);
+	uint32_t dimension = info.dimension - 1;
+
+	std::vector<uint32_t> dfd = {
+		4 + blockSize,
+		0,
+		2 | blockSize << 16,
+		info.model | KHR_DF_PRIMARIES_BT709 << 8 |
+			(info.srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16,
+		dimension | dimension << 8,
+		static_cast<uint32_t>(info.bytes),
+		0
+	};
+
+	dfd.insert(dfd.end(), samples.begin(), samples.end());
+	return dfd;
+}
+
+void imTextureFile::Load(const std::string &filename, bool srgb) {
+	std::ifstream stream(filename, std::ios::ate | std::ios::binary);
+	if (!stream.is_open()) {
+		throw std::runtime_error("Failed to open texture file!");
+	}
+
+	// Levels are uploaded straight out of the file contents.
+	size_t fileSize = (size_t)stream.tellg();
+	data.resize(fileSize);
+	stream.seekg(0);
+	stream.read(reinterpret_cast<char *>(data.data()), fileSize);
+	generateMips = false;
+
+	if (fileSize >= sizeof(KTX2_IDENTIFIER) &&
+			memcmp(data.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0) {
+		LoadKTX2(data);
+	} else if (fileSize >= DDS_MAGIC_SIZE && memcmp(data.data(), "DDS ", 4) == 0) {
+		LoadDDS(data, srgb);
+	} else {
+		throw std::runtime_error("Texture file is neither KTX2 nor DDS!");
+	}
+}
+
+void imTextureFile::Save(const std::string &filename) const {
+	std::vector<uint32_t> dfd = DataFormatDescriptor(format);
+	uint32_t levelCount = static_cast<uint32_t>(levels.size());
+	size_t dfdOffset = KTX2_LEVEL_INDEX + levels.size() * 24;
+	size_t dataOffset = dfdOffset + dfd.size() * 4;
+
+	// Smallest level first, each aligned to its block size and to 4 bytes.
+	size_t align = std::max<size_t>(static_cast<size_t>(BlockInfo(format).bytes), 4);
+	std::vector<uint64_t> offsets(levels.size());
+	for (size_t level = levels.size(); level-- > 0; ) {
+		dataOffset = (dataOffset + align - 1) / align * align;
+		offsets[level] = dataOffset;
+		dataOffset += levels[level].size;
+	}
+
+	std::vector<uint8_t> file(dataOffset, 0);
+	auto write32 = [&file](size_t offset, uint32_t value) {
+		for (size_t i = 0; i < 4; i++) { file[offset + i] = value >> (8 * i) & 0xFF; }
+	};
+	auto write64 = [&write32](size_t offset, uint64_t value) {
+		write32(offset, static_cast<uint32_t>(value));
+		write32(offset + 4, static_cast<uint32_t>(value >> 32));
+	};
+
+	memcpy(file.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	write32(12, static_cast<uint32_t>(format));
+	write32(16, 1);
+	write32(20, width);
+	write32(24, height);
+	write32(36, 1);
+	write32(40, levelCount);
+	write32(48, static_cast<uint32_t>(dfdOffset));
+	write32(52, static_cast<uint32_t>(dfd.size() * 4));
+
+	for (size_t level = 0; level < levels.size(); level++) {
+		size_t entry = KTX2_LEVEL_INDEX + level * 24;
+		write64(entry, offsets[level]);
+		write64(entry + 8, levels[level].size);
+		write64(entry + 16, levels[level].size);
+		memcpy(file.data() + offsets[level], data.data() + levels[level].offset,
+			levels[level].size);
+	}
+
+	for (size_t i = 0; i < dfd.size(); i++) {
+		write32(dfdOffset + i * 4, dfd[i]);
+	}
+
+	std::ofstream stream(filename, std::ios::binary | std::ios::trunc);
+	if (!stream.write(reinterpret_cast<const char *>(file.data()), file.size())) {
+		throw std::runtime_error("Failed to write texture file!");
+	}
+}
+
+bool imTextureFile::IsContainer(const std::string &filename) {
+	size_t dot = filename.find_last_of('.');
+	if (dot == std::string::npos) {
+		return false;
+	}
+
+	std::string extension = filename.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension == "ktx2" || extension == "dds";
+}
+
+VkDeviceSize imTextureFile::LevelSize(VkFormat format, uint32_t width, uint32_t height) {
+	imBlockInfo info = BlockInfo(format);
+	VkDeviceSize blocksWide = std::max((width + info.dimension - 1) / info.dimension, 1u);
+	VkDeviceSize blocksHigh = std::max((height + info.dimension - 1) / info.dimension, 1u);
+	return blocksWide * blocksHigh * info.bytes;
+}
+
+void imTextureFile::LoadKTX2(const std::vector<uint8_t> &file) {
+	if (file.size() < KTX2_LEVEL_INDEX) {
+		throw std::runtime_error("Truncated KTX2 header!");
+	}
+
+	format = static_cast<VkFormat>(ReadValue<uint32_t>(file, 12));
+	width = ReadValue<uint32_t>(file, 20);
+	height = ReadValue<uint32_t>(file, 24);
+	uint32_t depth = ReadValue<uint32_t>(file, 28);
+	uint32_t layerCount = ReadValue<uint32_t>(file, 32);
+	uint32_t faceCount = ReadValue<uint32_t>(file, 36);
+	// Zero asks the loader to generate mips, the index still lists level 0.
+	generateMips = ReadValue<uint32_t>(file, 40) == 0;
+	uint32_t levelCount = std::max(ReadValue<uint32_t>(file, 40), 1u);
+	uint32_t indexCount = levelCount;
+	uint32_t supercompression = ReadValue<uint32_t>(file, 44);
+
+	if (BlockInfo(format).bytes == 0) {
+		throw std::runtime_error("KTX2 file is not RGBA8, BC1, BC3, BC5 or BC7!");
+	}
+
+	if (generateMips && BlockInfo(format).dimension != 1) {
+		throw std::runtime_error("Block compressed KTX2 files must store every mip level!");
+	}
+
+	if (supercompression != 0) {
+		throw std::runtime_error("Supercompressed KTX2 files are not supported!");
+	}
+
+	if (width == 0 || height == 0 || depth > 1 || layerCount > 1 || faceCount != 1) {
+		throw std::runtime_error("KTX2 file is not a single 2D texture!");
+	}
+
+	if (file.size() < KTX2_LEVEL_INDEX + static_cast<size_t>(indexCount) * 24) {
+		throw std::runtime_error("Truncated KTX2 level index!");
+	}
+
+	// Anything past 1x1 is ignored.
+	levelCount = std::min(levelCount, imMipChain::LevelsFor(width, height));
+
+	// The index lists level 0 first, though the data stores it last.
+	std::vector<uint64_t> offsets(levelCount);
+	for (uint32_t level = 0; level < levelCount; level++) {
+		size_t entry = KTX2_LEVEL_INDEX + level * 24;
+		offsets[level] = ReadValue<uint64_t>(file, entry);
+
+		uint64_t length = ReadValue<uint64_t>(file, entry + 8);
+		if (length != LevelSize(format, std::max(width >> level, 1u),
+				std::max(height >> level, 1u))) {
+			throw std::runtime_error("KTX2 level has an unexpected size!");
+		}
+	}
+
+	ReadLevels(file, offsets);
+}
+
+void imTextureFile::LoadDDS(const std::vector<uint8_t> &file, bool srgb) {
+	if (file.size() < DDS_MAGIC_SIZE + DDS_HEADER_SIZE) {
+		throw std::runtime_error("Truncated DDS header!");
+	}
+
+	// Offsets below include the magic number.
+	uint32_t flags = ReadValue<uint32_t>(file, 8);
+	height = ReadValue<uint32_t>(file, 12);
+	width = ReadValue<uint32_t>(file, 16);
+	uint32_t levelCount = (flags & DDSD_MIPMAPCOUNT) ?
+		std::max(ReadValue<uint32_t>(file, 28), 1u) : 1;
+	uint32_t fourCC = ReadValue<uint32_t>(file, 84);
+	uint32_t caps2 = ReadValue<uint32_t>(file, 112);
+
+	if (width == 0 || height == 0 || (caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME))) {
+		throw std::runtime_error("DDS file is not a single 2D texture!");
+	}
+
+	levelCount = std::min(levelCount, imMipChain::LevelsFor(width, height));
+
+	size_t dataOffset = DDS_MAGIC_SIZE + DDS_HEADER_SIZE;
+	if (fourCC == FourCC("DX10")) {
+		if (file.size() < dataOffset + DDS_DX10_SIZE) {
+			throw std::runtime_error("Truncated DDS header!");
+		}
+
+		uint32_t arraySize = ReadValue<uint32_t>(file, dataOffset + 12);
+		if (arraySize > 1) {
+			throw std::runtime_error("DDS file is not a single 2D texture!");
+		}
+
+		switch (ReadValue<uint32_t>(file, dataOffset)) {
+			case DXGI_FORMAT_BC1_UNORM: format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;
+			case DXGI_FORMAT_BC1_UNORM_SRGB: format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK; break;
+			case DXGI_FORMAT_BC3_UNORM: format = VK_FORMAT_BC3_UNORM_BLOCK; break;
+			case DXGI_FORMAT_BC3_UNORM_SRGB: format = VK_FORMAT_BC3_SRGB_BLOCK; break;
+			case DXGI_FORMAT_BC5_UNORM: format = VK_FORMAT_BC5_UNORM_BLOCK; break;
+			case DXGI_FORMAT_BC5_SNORM: format = VK_FORMAT_BC5_SNORM_BLOCK; break;
+			case DXGI_FORMAT_BC7_UNORM: format = VK_FORMAT_BC7_UNORM_BLOCK; break;
+			case DXGI_FORMAT_BC7_UNORM_SRGB: format = VK_FORMAT_BC7_SRGB_BLOCK; break;
+			default:
+				throw std::runtime_error("DDS file is not BC1, BC3, BC5 or BC7!");
+		}
+
+		dataOffset += DDS_DX10_SIZE;
+	} else if (fourCC == FourCC("DXT1")) {
+		format = srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	} else if (fourCC == FourCC("DXT5")) {
+		format = srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+	} else if (fourCC == FourCC("ATI2") || fourCC == FourCC("BC5U")) {
+		format = VK_FORMAT_BC5_UNORM_BLOCK;
+	} else if (fourCC == FourCC("BC5S")) {
+		format = VK_FORMAT_BC5_SNORM_BLOCK;
+	} else {
+		throw std::runtime_error("DDS file is not BC1, BC3, BC5 or BC7!");
+	}
+
+	// Levels follow the header back to back, largest first.
+	std::vector<uint64_t> offsets(levelCount);
+	for (uint32_t level = 0; level < levelCount; level++) {
+		offsets[level] = dataOffset;
+		dataOffset += LevelSize(format, std::max(width >> level, 1u),
+			std::max(height >> level, 1u));
+	}
+
+	ReadLevels(file, offsets);
+}
+
+void imTextureFile::ReadLevels(const std::vector<uint8_t> &file,
+		const std::vector<uint64_t> &offsets) {
+	levels.clear();
+
+	for (size_t level = 0; level < offsets.size(); level++) {
+		uint32_t levelWidth = std::max(width >> level, 1u);
+		uint32_t levelHeight = std::max(height >> level, 1u);
+		size_t size = static_cast<size_t>(LevelSize(format, levelWidth, levelHeight));
+
+		if (offsets[level] > file.size() || file.size() - offsets[level] < size) {
+			throw std::runtime_error("Texture file is missing mip level data!");
+		}
+
+		levels.push_back({ static_cast<size_t>(offsets[level]), size });
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef IM_TEXTURE_FILE_H
+#define IM_TEXTURE_FILE_H
+
+#include "imVulkan.h"
+
+/// Texture read from a KTX2 or DDS container, with every mip level stored
+/// exactly as the GPU consumes it. BC1 and BC7 take 0.5 and 1 byte per
+/// texel against 4 for RGBA8, and need no decode on load.
+class imTextureFile {
+public:
+	/// Read 'filename', which must hold RGBA8 texels (KTX2 only) or BC1, BC3,
+	/// BC5 or BC7 blocks, without supercompression. Legacy DDS files don't
+	/// record a color space, 'srgb' picks one for BC1 and BC3 there, the
+	/// other formats keep their own.
+	void Load(const std::string &filename, bool srgb);
+	/// Write every level as a KTX2 file, which Load() reads back.
+	void Save(const std::string &filename) const;
+
+	/// True if 'filename' has an extension Load() understands.
+	static bool IsContainer(const std::string &filename);
+	/// Bytes in one 'width' by 'height' level of a supported 'format', 0 for
+	/// any other.
+	static VkDeviceSize LevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+	/// Byte range of one mip level within 'data', largest level first.
+	struct Level {
+		size_t offset;
+		size_t size;
+	};
+
+	VkFormat format;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<Level> levels;
+	/// Set when a KTX2 file stores level 0 only and asks the loader to
+	/// generate the rest, which only RGBA8 files may do.
+	bool generateMips = false;
+	/// Contents of the whole file after Load(), headers included. Save()
+	/// only writes the ranges in 'levels'.
+	std::vector<uint8_t> data;
+
+private:
+	void LoadKTX2(const std::vector<uint8_t> &file);
+	void LoadDDS(const std::vector<uint8_t> &file, bool srgb);
+	/// Check that each level, starting at 'offsets', lies within 'file'.
+	void ReadLevels(const std::vector<uint8_t> &file,
+		const std::vector<uint64_t> &offsets);
+};
+
+#endif
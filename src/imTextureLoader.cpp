@@ -0,0 +1,237 @@
+#include "imTextureLoader.h"
+#include "imThreadPool.h"
+#include "imBindlessTextures.h"
+
+imTextureLoader textureLoader;
+
+/// Side of the placeholder, and of each of its checks.
+static const uint32_t PLACEHOLDER_SIZE = 8;
+static const uint32_t PLACEHOLDER_CHECK = 4;
+
+static double SecondsSince(std::chrono::high_resolution_clock::time_point start) {
+	auto now = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::chrono::seconds::period>(now - start).count();
+}
+
+void imTextureLoader::Create() {
+	// Grey and magenta checks, so a texture still loading is easy to spot.
+	imImageData data;
+	data.format = VK_FORMAT_R8G8B8A8_UNORM;
+	data.width = PLACEHOLDER_SIZE;
+	data.height = PLACEHOLDER_SIZE;
+	data.levels.emplace_back();
+
+	for (uint32_t y = 0; y < PLACEHOLDER_SIZE; y++) {
+		for (uint32_t x = 0; x < PLACEHOLDER_SIZE; x++) {
+			bool odd = (x / PLACEHOLDER_CHECK + y / PLACEHOLDER_CHECK) % 2 == 1;
+			const uint8_t grey[] = { 128, 128, 128, 255 };
+			const uint8_t magenta[] = { 255, 0, 255, 255 };
+			data.levels[0].insert(data.levels[0].end(), odd ? magenta : grey,
+				(odd ? magenta : grey) + 4);
+		}
+	}
+
+	placeholder.Create(data);
+	if (bindlessTextures.enabled) {
+		placeholderIndex = bindlessTextures.Register(placeholder);
+	}
+}
+
+imTextureHandle imTextureLoader::Load(const std::string &filename, bool srgb,
+		bool stream) {
+	imTextureHandle handle = static_cast<imTextureHandle>(entries.size());
+	entries.emplace_back();
+
+	Entry * entry = &entries.back();
+	entry->filename = filename;
+	entry->srgb = srgb;
+	entry->stream = stream;
+	entry->requested = std::chrono::high_resolution_clock::now();
+
+	threadPool.Submit([this, entry, handle] {
+		auto start = std::chrono::high_resolution_clock::now();
+		imImageData data;
+		std::string error;
+
+		// Jobs must not throw, failures are reported by the render thread.
+		try {
+			// The streamer uploads from any level, so it needs all of them on the CPU.
+			data = imImage::Decode(entry->filename, entry->srgb, entry->stream);
+		} catch (std::exception &e) {
+			error = e.what();
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		entry->data = std::move(data);
+		entry->error = error;
+		entry->decodeSeconds = SecondsSince(start);
+		decoded.push_back(handle);
+	});
+
+	return handle;
+}
+
+void imTextureLoader::Update() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		staging.insert(staging.end(), decoded.begin(), decoded.end());
+		decoded.clear();
+	}
+
+	// Always stage at least one texture, however large, so nothing starves.
+	VkDeviceSize budget = TEXTURE_UPLOAD_BUDGET;
+	std::vector<imTextureHandle> staged;
+	while (!staging.empty()) {
+		Entry &entry = entries[staging.front()];
+
+		if (!entry.error.empty()) {
+			std::cerr << "Failed to load texture " << entry.filename << ": "
+				<< entry.error << std::endl;
+			entry.state = FAILED;
+			failed++;
+			staging.pop_front();
+			continue;
+		}
+
+		// The streamer keeps to its own upload budget.
+		if (entry.stream) {
+			entry.streamHandle = textureStreamer.Add(std::move(entry.data));
+			entry.data = imImageData();
+			entry.state = READY;
+			streaming.push_back(staging.front());
+			staging.pop_front();
+			continue;
+		}
+
+		VkDeviceSize size = 0;
+		for (const std::vector<uint8_t> &level : entry.data.levels) {
+			size += level.size();
+		}
+
+		if (!staged.empty() && size > budget) {
+			break;
+		}
+
+		entry.image.Create(entry.data);
+		entry.data = imImageData();
+		entry.state = UPLOADING;
+
+		budget -= std::min(size, budget);
+		uploadedBytes += size;
+		staged.push_back(staging.front());
+		staging.pop_front();
+	}
+
+	if (!staged.empty()) {
+		imUploadToken token = stagingRing.Flush();
+		for (imTextureHandle handle : staged) {
+			entries[handle].token = token;
+			uploading.push_back(handle);
+		}
+	}
+
+	for (auto it = uploading.begin(); it != uploading.end(); ) {
+		Entry &entry = entries[*it];
+		if (!stagingRing.IsComplete(entry.token)) {
+			it++;
+			continue;
+		}
+
+		if (bindlessTextures.enabled) {
+			entry.bindlessIndex = bindlessTextures.Register(entry.image);
+		}
+
+		entry.state = READY;
+		loaded++;
+		totalDecodeSeconds += entry.decodeSeconds;
+		totalLoadSeconds += SecondsSince(entry.requested);
+		it = uploading.erase(it);
+	}
+
+	// Streamed textures count as loaded once their tail is resident.
+	for (auto it = streaming.begin(); it != streaming.end(); ) {
+		Entry &entry = entries[*it];
+		if (textureStreamer.Get(entry.streamHandle) == nullptr) {
+			it++;
+			continue;
+		}
+
+		loaded++;
+		totalDecodeSeconds += entry.decodeSeconds;
+		totalLoadSeconds += SecondsSince(entry.requested);
+		it = streaming.erase(it);
+	}
+}
+
+bool imTextureLoader::IsReady(imTextureHandle handle) const {
+	const Entry &entry = Find(handle);
+	if (entry.state == READY && entry.stream) {
+		return textureStreamer.Get(entry.streamHandle) != nullptr;
+	}
+
+	return entry.state == READY;
+}
+
+const imImage & imTextureLoader::Get(imTextureHandle handle) const {
+	const Entry &entry = Find(handle);
+	if (entry.state == READY && entry.stream) {
+		const imImage * image = textureStreamer.Get(entry.streamHandle);
+		return image ? *image : placeholder;
+	}
+
+	return entry.state == READY ? entry.image : placeholder;
+}
+
+uint32_t imTextureLoader::BindlessIndex(imTextureHandle handle) const {
+	const Entry &entry = Find(handle);
+	if (entry.state == READY && entry.stream) {
+		return textureStreamer.Get(entry.streamHandle) ?
+			textureStreamer.BindlessIndex(entry.streamHandle) : placeholderIndex;
+	}
+
+	return entry.state == READY ? entry.bindlessIndex : placeholderIndex;
+}
+
+void imTextureLoader::Demand(imTextureHandle handle, float pixels) {
+	const Entry &entry = Find(handle);
+	if (entry.state == READY && entry.stream) {
+		textureStreamer.Demand(entry.streamHandle, pixels);
+	}
+}
+
+void imTextureLoader::PrintStats() {
+	std::cout << "Textures: " << loaded << " loaded, " << failed << " failed, "
+		<< entries.size() - loaded - failed << " pending, "
+		<< uploadedBytes / (1024.0 * 1024.0) << " MiB staged" << std::endl;
+	if (loaded > 0) {
+		std::cout << "\t- " << totalDecodeSeconds * 1000.0 / loaded << " ms decode, "
+			<< totalLoadSeconds * 1000.0 / loaded << " ms until resident, on average"
+			<< std::endl;
+	}
+
+	std::cout << "-----------------------------------------------" << std::endl;
+}
+
+void imTextureLoader::Cleanup() {
+	// Streamed images belong to the streamer, which destroys them itself.
+	for (Entry &entry : entries) {
+		if (!entry.stream && (entry.state == UPLOADING || entry.state == READY)) {
+			entry.image.Cleanup();
+		}
+	}
+
+	placeholder.Cleanup();
+	entries.clear();
+	staging.clear();
+	uploading.clear();
+	streaming.clear();
+	decoded.clear();
+}
+
+const imTextureLoader::Entry & imTextureLoader::Find(imTextureHandle handle) const {
+	if (handle >= entries.size()) {
+		throw std::runtime_error("Invalid texture handle!");
+	}
+
+	return entries[handle];
+}
@@ -0,0 +1,113 @@
+#ifndef IM_TEXTURE_LOADER_H
+#define IM_TEXTURE_LOADER_H
+
+#include "imVulkan.h"
+#include "imImage.h"
+#include "imStagingRing.h"
+#include "imTextureStreamer.h"
+
+#include <mutex>
+#include <deque>
+
+/// Identifies a texture requested from imTextureLoader.
+typedef uint32_t imTextureHandle;
+
+/// Most bytes the loader stages per Update(), the ring blocks once full so
+/// a burst of finished decodes is spread over a few frames instead.
+const VkDeviceSize TEXTURE_UPLOAD_BUDGET = IM_STAGING_RING_SIZE / 2;
+
+/// Loads textures in the background. Files are read and decoded on the
+/// thread pool, the render thread only creates images and stages their
+/// texels, a few per frame, so neither disk nor decode ever stall a frame.
+/// Handles resolve to a placeholder until their texture is resident, and
+/// forever if it failed to load. Streamed textures are handed over to the
+/// texture streamer once decoded, which then decides their resident levels.
+class imTextureLoader {
+public:
+	/// Create the placeholder, which uploads with the next staging ring flush.
+	void Create();
+
+	/// Start loading 'filename', returns at once. See imImage::Create. With
+	/// 'stream' set only the levels its demand needs are kept resident.
+	imTextureHandle Load(const std::string &filename, bool srgb = true,
+		bool stream = false);
+	/// Stage decoded textures and publish those whose upload has finished.
+	/// Call once per frame from the render thread.
+	void Update();
+
+	/// True once the texture itself is resident.
+	bool IsReady(imTextureHandle handle) const;
+	/// The texture if resident, otherwise the placeholder.
+	const imImage & Get(imTextureHandle handle) const;
+	/// Index of Get(handle) in the bindless table, if it is enabled.
+	uint32_t BindlessIndex(imTextureHandle handle) const;
+	/// Forward the on screen size of a streamed texture to the streamer,
+	/// ignored for other textures and those still decoding.
+	void Demand(imTextureHandle handle, float pixels);
+
+	/// Print how many textures loaded and how long they took.
+	void PrintStats();
+	/// Destroy every texture, the thread pool must be idle.
+	void Cleanup();
+
+private:
+	enum State {
+		/// Queued on or running in the thread pool.
+		DECODING,
+		/// Decoded, waiting for the render thread to stage it.
+		DECODED,
+		/// Staged, waiting for its batch to complete.
+		UPLOADING,
+		/// Ready, or handed over to the texture streamer if streamed.
+		READY,
+		FAILED
+	};
+
+	struct Entry {
+		std::string filename;
+		bool srgb;
+		bool stream;
+		State state = DECODING;
+		std::chrono::high_resolution_clock::time_point requested;
+
+		/// Written by the worker, read by the render thread once DECODED.
+		imImageData data;
+		std::string error;
+		double decodeSeconds = 0.0;
+
+		imImage image;
+		imUploadToken token = 0;
+		uint32_t bindlessIndex = 0;
+		imStreamHandle streamHandle = 0;
+	};
+
+	/// Entry for 'handle', throws if there is none.
+	const Entry & Find(imTextureHandle handle) const;
+
+	/// Deque, so workers may keep pointers to entries while more are added.
+	std::deque<Entry> entries;
+	/// Guards 'decoded' and the worker written fields of every entry.
+	std::mutex mutex;
+	/// Handles finished by workers since the last Update(), decoded or failed.
+	std::vector<imTextureHandle> decoded;
+	/// Handles decoded but left over by the upload budget, oldest first.
+	std::deque<imTextureHandle> staging;
+	/// Handles waiting on their upload.
+	std::vector<imTextureHandle> uploading;
+	/// Streamed handles whose tail the streamer has yet to make resident.
+	std::vector<imTextureHandle> streaming;
+
+	imImage placeholder;
+	uint32_t placeholderIndex = 0;
+
+	uint32_t loaded = 0;
+	uint32_t failed = 0;
+	uint64_t uploadedBytes = 0;
+	double totalDecodeSeconds = 0.0;
+	double totalLoadSeconds = 0.0;
+};
+
+/// Global texture loader.
+extern imTextureLoader textureLoader;
+
+#endif
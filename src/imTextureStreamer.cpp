@@ -0,0 +1,305 @@
+#include "imTextureStreamer.h"
+#include "imBindlessTextures.h"
+#include "imCommandContext.h"
+
+#include <algorithm>
+
+imTextureStreamer textureStreamer;
+
+imStreamHandle imTextureStreamer::Add(imImageData data) {
+	if (data.levels.size() != data.mipLevels) {
+		throw std::runtime_error("Streamed textures need every level decoded!");
+	}
+
+	Texture texture;
+	texture.data = std::move(data);
+
+	// The tail is small enough to keep however little the texture is shown.
+	uint32_t &tail = texture.tailLevel;
+	while (tail + 1 < texture.data.mipLevels &&
+			std::max(texture.data.width >> tail, texture.data.height >> tail) > STREAM_TAIL_SIZE) {
+		tail++;
+	}
+
+	texture.wantedLevel = tail;
+	textures.push_back(std::move(texture));
+	return static_cast<imStreamHandle>(textures.size() - 1);
+}
+
+void imTextureStreamer::Demand(imStreamHandle handle, float pixels) {
+	if (handle >= textures.size()) {
+		throw std::runtime_error("Invalid stream handle!");
+	}
+
+	Texture &texture = textures[handle];
+	if (texture.demandFrame != frameNumber) {
+		texture.demand = 0.0f;
+		texture.demandFrame = frameNumber;
+	}
+
+	texture.demand = std::max(texture.demand, pixels);
+}
+
+void imTextureStreamer::Update(uint64_t frameNumber) {
+	this->frameNumber = frameNumber;
+	imStreamingStats stats;
+
+	// Destroy replaced images no frame in flight can still sample.
+	for (auto it = retired.begin(); it != retired.end(); ) {
+		if (frameNumber >= it->frame + MAX_FRAMES_IN_FLIGHT) {
+			it->image.Cleanup();
+			it = retired.erase(it);
+		} else {
+			it++;
+		}
+	}
+
+	// Swap in every image whose upload has finished.
+	for (Texture &texture : textures) {
+		if (texture.pending && stagingRing.IsComplete(texture.token)) {
+			texture.pending = false;
+			Swap(texture, texture.next, texture.nextLevel);
+		}
+	}
+
+	for (Texture &texture : textures) {
+		texture.wantedLevel = DemandedLevel(texture);
+	}
+
+	FitBudget();
+
+	// Evictions go first as they free memory, then the most demanded textures.
+	std::vector<Texture *> requests;
+	for (Texture &texture : textures) {
+		if (!texture.pending && (!texture.resident ||
+				texture.wantedLevel != texture.residentLevel)) {
+			requests.push_back(&texture);
+		}
+	}
+
+	std::stable_sort(requests.begin(), requests.end(), [](Texture * a, Texture * b) {
+		bool evictA = a->resident && a->wantedLevel > a->residentLevel;
+		bool evictB = b->resident && b->wantedLevel > b->residentLevel;
+		if (evictA != evictB) { return evictA; }
+		return a->demand > b->demand;
+	});
+
+	VkDeviceSize uploadBudget = STREAM_UPLOAD_BUDGET;
+	VkDeviceSize held = HeldBytes();
+	std::vector<Texture *> started;
+	bool copied = false;
+	for (Texture * texture : requests) {
+		// The coarser levels are resident already, copy rather than restage
+		// them. Drawing picks the copy up after the next flush, which is
+		// submitted ahead of this frame on the same queue.
+		if (texture->resident && texture->wantedLevel > texture->residentLevel) {
+			imImage coarser;
+			coarser.CreateMipTail(texture->image,
+				texture->wantedLevel - texture->residentLevel);
+			stats.evictions += texture->wantedLevel - texture->residentLevel;
+			held += coarser.memory.size;
+			Swap(*texture, coarser, texture->wantedLevel);
+			copied = true;
+			copies++;
+			continue;
+		}
+
+		// A new texture shows its tail before anything finer. Tails are kept
+		// regardless, finer levels wait until they fit next to everything held.
+		uint32_t level = texture->resident ? texture->wantedLevel : texture->tailLevel;
+		VkDeviceSize size = LevelBytes(*texture, level);
+		if (texture->resident && held + size > budget) {
+			continue;
+		}
+
+		if (!started.empty() && size > uploadBudget) {
+			continue;
+		}
+
+		texture->next.Create(texture->data, level);
+		texture->nextLevel = level;
+		texture->pending = true;
+
+		uploadBudget -= std::min(size, uploadBudget);
+		held += texture->next.memory.size;
+		streamedBytes += size;
+		started.push_back(texture);
+	}
+
+	if (copied) {
+		oneTimeCommands.Flush(false);
+	}
+
+	if (!started.empty()) {
+		imUploadToken token = stagingRing.Flush();
+		for (Texture * texture : started) {
+			texture->token = token;
+		}
+	}
+
+	stats.residentBytes = HeldBytes();
+	for (const Texture &texture : textures) {
+		if (texture.pending || !texture.resident ||
+				texture.wantedLevel != texture.residentLevel) {
+			stats.pendingRequests++;
+		}
+	}
+
+	peakResidentBytes = std::max(peakResidentBytes, stats.residentBytes);
+	totalEvictions += stats.evictions;
+	frameStats = stats;
+}
+
+const imImage * imTextureStreamer::Get(imStreamHandle handle) const {
+	if (handle >= textures.size()) {
+		throw std::runtime_error("Invalid stream handle!");
+	}
+
+	return textures[handle].resident ? &textures[handle].image : nullptr;
+}
+
+uint32_t imTextureStreamer::BindlessIndex(imStreamHandle handle) const {
+	if (handle >= textures.size()) {
+		throw std::runtime_error("Invalid stream handle!");
+	}
+
+	return textures[handle].bindlessIndex;
+}
+
+void imTextureStreamer::PrintStats() {
+	std::cout << "Texture Streaming: " << textures.size() << " textures, "
+		<< peakResidentBytes / (1024.0 * 1024.0) << " MiB peak of a "
+		<< budget / (1024.0 * 1024.0) << " MiB budget" << std::endl;
+	std::cout << "\t- " << streamedBytes / (1024.0 * 1024.0) << " MiB streamed, "
+		<< swaps << " swaps, " << copies << " copied on the GPU, " << totalEvictions
+		<< " levels evicted" << std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
+}
+
+void imTextureStreamer::Cleanup() {
+	for (Texture &texture : textures) {
+		if (texture.resident) {
+			texture.image.Cleanup();
+		}
+
+		if (texture.pending) {
+			texture.next.Cleanup();
+		}
+	}
+
+	for (Retired &image : retired) {
+		image.image.Cleanup();
+	}
+
+	textures.clear();
+	retired.clear();
+}
+
+VkDeviceSize imTextureStreamer::LevelBytes(const Texture &texture, uint32_t level) {
+	VkDeviceSize bytes = 0;
+	for (size_t i = level; i < texture.data.levels.size(); i++) {
+		bytes += texture.data.levels[i].size();
+	}
+
+	return bytes;
+}
+
+VkDeviceSize imTextureStreamer::HeldBytes() const {
+	VkDeviceSize bytes = 0;
+	for (const Texture &texture : textures) {
+		if (texture.resident) {
+			bytes += texture.image.memory.size;
+		}
+
+		if (texture.pending) {
+			bytes += texture.next.memory.size;
+		}
+	}
+
+	for (const Retired &image : retired) {
+		bytes += image.image.memory.size;
+	}
+
+	return bytes;
+}
+
+void imTextureStreamer::Swap(Texture &texture, const imImage &image, uint32_t level) {
+	if (texture.resident) {
+		retired.push_back({ texture.image, frameNumber });
+		if (bindlessTextures.enabled) {
+			bindlessTextures.Unregister(texture.bindlessIndex);
+		}
+	}
+
+	texture.image = image;
+	texture.residentLevel = level;
+	texture.resident = true;
+	if (bindlessTextures.enabled) {
+		texture.bindlessIndex = bindlessTextures.Register(texture.image);
+	}
+
+	swaps++;
+}
+
+uint32_t imTextureStreamer::DemandedLevel(const Texture &texture) const {
+	bool shown = texture.demand > 0.0f &&
+		texture.demandFrame + STREAM_IDLE_FRAMES >= frameNumber;
+	if (!shown) {
+		return texture.tailLevel;
+	}
+
+	// Finest level needed is the smallest still covering the demand.
+	uint32_t side = std::max(texture.data.width, texture.data.height);
+	uint32_t level = 0;
+	while (level < texture.tailLevel && (side >> (level + 1)) >= texture.demand) {
+		level++;
+	}
+
+	return level;
+}
+
+void imTextureStreamer::FitBudget() {
+	// Images a pending upload replaces are held for as long as the upload
+	// takes. Retired images are not counted, they already reflect a drop and
+	// are gone within MAX_FRAMES_IN_FLIGHT frames, counting them would evict
+	// again for every eviction. Update() keeps them out of the budget by
+	// staging nothing finer until they have been freed.
+	VkDeviceSize total = 0;
+	for (const Texture &texture : textures) {
+		total += LevelBytes(texture, texture.wantedLevel);
+		if (texture.pending && texture.resident) {
+			total += texture.image.memory.size;
+		}
+	}
+
+	while (total > budget) {
+		Texture * victim = nullptr;
+		for (Texture &texture : textures) {
+			if (texture.wantedLevel < texture.tailLevel &&
+					(victim == nullptr || EvictBefore(texture, *victim))) {
+				victim = &texture;
+			}
+		}
+
+		// Only tails are left, which are kept whatever the budget.
+		if (victim == nullptr) {
+			break;
+		}
+
+		total -= victim->data.levels[victim->wantedLevel].size();
+		victim->wantedLevel++;
+	}
+}
+
+bool imTextureStreamer::EvictBefore(const Texture &a, const Texture &b) const {
+	if (a.demandFrame != b.demandFrame) {
+		return a.demandFrame < b.demandFrame;
+	}
+
+	// Otherwise whichever has the most texels per pixel to spare.
+	float spareA = std::max(a.data.width, a.data.height) / static_cast<float>(
+		1u << a.wantedLevel) / std::max(a.demand, 1.0f);
+	float spareB = std::max(b.data.width, b.data.height) / static_cast<float>(
+		1u << b.wantedLevel) / std::max(b.demand, 1.0f);
+	return spareA > spareB;
+}
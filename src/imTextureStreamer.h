@@ -0,0 +1,131 @@
+#ifndef IM_TEXTURE_STREAMER_H
+#define IM_TEXTURE_STREAMER_H
+
+#include "imVulkan.h"
+#include "imImage.h"
+#include "imStagingRing.h"
+
+/// Identifies a texture added to imTextureStreamer.
+typedef uint32_t imStreamHandle;
+
+/// Levels no larger than this along either side are always resident.
+const uint32_t STREAM_TAIL_SIZE = 64;
+/// Frames a texture keeps its fine levels after it was last demanded.
+const uint64_t STREAM_IDLE_FRAMES = 120;
+/// Default budget for every streamed level, the tails are always kept.
+const VkDeviceSize STREAM_DEFAULT_BUDGET = 256 * 1024 * 1024;
+/// Most bytes streamed in per Update(), at least one texture always is.
+const VkDeviceSize STREAM_UPLOAD_BUDGET = IM_STAGING_RING_SIZE / 4;
+
+/// Streaming state at the end of one Update().
+struct imStreamingStats {
+	/// Device memory held by streamed images, including those on their way
+	/// in or out.
+	VkDeviceSize residentBytes = 0;
+	/// Textures whose resident levels differ from those they want.
+	uint32_t pendingRequests = 0;
+	/// Levels dropped to stay within the budget or because nothing showed
+	/// them any longer.
+	uint32_t evictions = 0;
+};
+
+/// Keeps only the mip levels each texture needs on screen resident. Every
+/// texture's full chain stays on the CPU, its coarsest levels (the tail)
+/// are uploaded first, and finer levels follow as draws demand them. A
+/// texture changes its levels by building a new image that starts at the
+/// wanted level, staged from the CPU to gain levels and copied from the
+/// resident image to drop them, and swapping it in once ready. The old one
+/// is destroyed once no frame in flight can use it. Every image held counts
+/// against 'budget', including those on their way in or out. When it is
+/// exceeded, the least recently and least densely shown textures drop
+/// their finest levels first, and no finer levels are staged until the
+/// replaced images have been freed.
+class imTextureStreamer {
+public:
+	/// Take over 'data', which must hold every level. Its tail uploads with
+	/// the next Update().
+	imStreamHandle Add(imImageData data);
+	/// Report that 'handle' is drawn covering 'pixels' along its longer side,
+	/// the largest report of a frame wins.
+	void Demand(imStreamHandle handle, float pixels);
+	/// Swap in finished images, retire old ones, and start uploads towards
+	/// the levels each texture now wants. Call once per frame.
+	void Update(uint64_t frameNumber);
+
+	/// The resident image, nullptr until the tail has uploaded.
+	const imImage * Get(imStreamHandle handle) const;
+	/// Index of Get(handle) in the bindless table, if it is enabled.
+	uint32_t BindlessIndex(imStreamHandle handle) const;
+
+	/// Print peak usage and totals.
+	void PrintStats();
+	/// Destroy every image, the device must be idle.
+	void Cleanup();
+
+	/// Bytes of streamed levels to keep resident, may change at any time.
+	VkDeviceSize budget = STREAM_DEFAULT_BUDGET;
+	/// State after the last Update().
+	imStreamingStats frameStats;
+
+private:
+	struct Texture {
+		/// Every level of the texture.
+		imImageData data;
+		/// Finest level that is always resident.
+		uint32_t tailLevel = 0;
+
+		/// Image holding 'residentLevel' and coarser, once 'resident' is set.
+		bool resident = false;
+		imImage image;
+		uint32_t residentLevel = 0;
+		uint32_t bindlessIndex = 0;
+
+		/// Replacement image being uploaded, if 'pending' is set.
+		bool pending = false;
+		imImage next;
+		uint32_t nextLevel = 0;
+		imUploadToken token = 0;
+
+		/// Largest demand of 'demandFrame', in pixels.
+		float demand = 0.0f;
+		uint64_t demandFrame = 0;
+		/// Finest level this frame's demand and the budget allow.
+		uint32_t wantedLevel = 0;
+	};
+
+	/// An image swapped out during 'frame'.
+	struct Retired {
+		imImage image;
+		uint64_t frame;
+	};
+
+	/// Bytes of levels 'level' and coarser.
+	static VkDeviceSize LevelBytes(const Texture &texture, uint32_t level);
+	/// Device memory of every image held, resident, pending or retired.
+	VkDeviceSize HeldBytes() const;
+	/// Replace the resident image of 'texture' with 'image', starting at 'level'.
+	void Swap(Texture &texture, const imImage &image, uint32_t level);
+	/// Finest level 'texture' needs for its demand, ignoring the budget.
+	uint32_t DemandedLevel(const Texture &texture) const;
+	/// Raise wanted levels, least important first, until they fit the budget
+	/// alongside the images pending uploads will replace.
+	void FitBudget();
+	/// True if 'a' should drop a level before 'b'.
+	bool EvictBefore(const Texture &a, const Texture &b) const;
+
+	std::vector<Texture> textures;
+	std::vector<Retired> retired;
+	/// Frame last passed to Update().
+	uint64_t frameNumber = 0;
+
+	VkDeviceSize peakResidentBytes = 0;
+	uint64_t streamedBytes = 0;
+	uint64_t totalEvictions = 0;
+	uint32_t swaps = 0;
+	uint32_t copies = 0;
+};
+
+/// Global texture streamer, fed by the texture loader.
+extern imTextureStreamer textureStreamer;
+
+#endif
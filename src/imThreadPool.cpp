@@ -0,0 +1,77 @@
+#include "imThreadPool.h"
+
+#include <algorithm>
+
+imThreadPool threadPool;
+
+void imThreadPool::Create(uint32_t threadCount) {
+	if (threadCount == 0) {
+		// hardware_concurrency() may report 0 if it can't tell.
+		threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	}
+
+	stopping = false;
+	for (uint32_t i = 0; i < threadCount; i++) {
+		threads.emplace_back(&imThreadPool::Work, this);
+	}
+}
+
+void imThreadPool::Submit(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+		pending++;
+	}
+
+	jobQueued.notify_one();
+}
+
+void imThreadPool::Wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	jobFinished.wait(lock, [this] { return pending == 0; });
+}
+
+void imThreadPool::Cleanup() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	jobQueued.notify_all();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	threads.clear();
+}
+
+void imThreadPool::Work() {
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobQueued.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+			// Drain the queue before stopping, so Cleanup() never drops work.
+			if (jobs.empty()) {
+				return;
+			}
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		try {
+			job();
+		} catch (const std::exception &e) {
+			std::cerr << "Background job failed: " << e.what() << std::endl;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pending--;
+		}
+
+		jobFinished.notify_all();
+	}
+}
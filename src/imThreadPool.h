@@ -0,0 +1,50 @@
+#ifndef IM_THREAD_POOL_H
+#define IM_THREAD_POOL_H
+
+#include "PREFIX.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <deque>
+
+/// Fixed set of worker threads running queued jobs in submission order.
+/// Jobs must not throw, an escaping exception is reported and dropped.
+class imThreadPool {
+public:
+	/// Start 'threadCount' workers, 0 leaves one hardware thread for the main thread.
+	void Create(uint32_t threadCount = 0);
+
+	/// Queue 'job' to run on the next free worker.
+	void Submit(std::function<void()> job);
+
+	/// Block until every job submitted so far has finished.
+	void Wait();
+
+	/// Finish the queued jobs and join the workers.
+	void Cleanup();
+
+	/// Number of worker threads.
+	uint32_t Size() const { return static_cast<uint32_t>(threads.size()); }
+
+private:
+	/// Worker loop, runs jobs until Cleanup().
+	void Work();
+
+	std::vector<std::thread> threads;
+	std::deque<std::function<void()>> jobs;
+
+	std::mutex mutex;
+	/// Signalled when a job is queued or the pool is stopping.
+	std::condition_variable jobQueued;
+	/// Signalled when a worker finishes a job.
+	std::condition_variable jobFinished;
+	/// Jobs queued or running.
+	uint32_t pending = 0;
+	bool stopping = false;
+};
+
+/// Global pool for background work, such as compiling pipelines.
+extern imThreadPool threadPool;
+
+#endif
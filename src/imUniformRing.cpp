@@ -0,0 +1,43 @@
+#include "imUniformRing.h"
+#include "imBuffer.h"
+
+#include <algorithm>
+
+imUniformRing uniformRing;
+
+void imUniformRing::Create(VkDeviceSize range, VkDeviceSize frameSize) {
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(physicalDevice, &props);
+	alignment = std::max<VkDeviceSize>(1, props.limits.minUniformBufferOffsetAlignment);
+
+	this->range = range;
+	// Every region must itself start on an aligned offset.
+	this->frameSize = (frameSize + alignment - 1) / alignment * alignment;
+
+	CreateBuffer(this->frameSize * MAX_FRAMES_IN_FLIGHT,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		buffer, memory);
+}
+
+void imUniformRing::BeginFrame(size_t frameIndex) {
+	frameBase = frameIndex * frameSize;
+	cursor = 0;
+}
+
+uint32_t imUniformRing::Allocate(VkDeviceSize size, void ** mapped) {
+	VkDeviceSize offset = (cursor + alignment - 1) / alignment * alignment;
+
+	// The descriptor always reads 'range' bytes, so that much must fit.
+	if (offset + std::max(size, range) > frameSize) {
+		throw std::runtime_error("Uniform ring is out of space for this frame!");
+	}
+
+	cursor = offset + size;
+	*mapped = static_cast<char *>(memory.mapped) + frameBase + offset;
+	return static_cast<uint32_t>(frameBase + offset);
+}
+
+void imUniformRing::Cleanup() {
+	DestroyBuffer(buffer, memory);
+}
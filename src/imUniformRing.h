@@ -0,0 +1,57 @@
+#ifndef IM_UNIFORM_RING_H
+#define IM_UNIFORM_RING_H
+
+#include "imVulkan.h"
+#include "imAllocator.h"
+
+/// Default number of bytes each frame in flight may sub-allocate.
+const VkDeviceSize IM_UNIFORM_RING_FRAME_SIZE = 256 * 1024;
+
+/// One persistently mapped uniform buffer, split into a region per frame in flight.
+/// Each region is a linear allocator that is reset when its frame begins, so
+/// per-object constants cost a pointer bump. Allocations are addressed through
+/// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC offsets rather than new descriptors.
+class imUniformRing {
+public:
+	/// Create the buffer, 'range' is the size of the largest struct that
+	/// will be bound through a dynamic descriptor.
+	void Create(VkDeviceSize range, VkDeviceSize frameSize = IM_UNIFORM_RING_FRAME_SIZE);
+
+	/// Start allocating from the given frame's region, discarding its old contents.
+	/// The frame's fence must have signalled.
+	void BeginFrame(size_t frameIndex);
+
+	/// Reserve 'size' bytes for the current frame, returns the dynamic offset
+	/// to bind them with and sets 'mapped' to the memory to write to.
+	uint32_t Allocate(VkDeviceSize size, void ** mapped);
+
+	/// Copy 'data' into the current frame and return its dynamic offset.
+	template <typename T>
+	uint32_t Push(const T &data) {
+		void * mapped;
+		uint32_t offset = Allocate(sizeof(T), &mapped);
+		memcpy(mapped, &data, sizeof(T));
+		return offset;
+	}
+
+	void Cleanup();
+
+	/// Buffer to point the dynamic descriptor at, with offset 0.
+	VkBuffer buffer = VK_NULL_HANDLE;
+	/// Range to give the dynamic descriptor.
+	VkDeviceSize range = 0;
+
+private:
+	imAllocation memory;
+	/// minUniformBufferOffsetAlignment, every allocation starts on a multiple of this.
+	VkDeviceSize alignment = 0;
+	VkDeviceSize frameSize = 0;
+	/// Start of the current frame's region and the next free byte within it.
+	VkDeviceSize frameBase = 0;
+	VkDeviceSize cursor = 0;
+};
+
+/// Global uniform ring shared by everything drawn in a frame.
+extern imUniformRing uniformRing;
+
+#endif
@@ -44,6 +44,45 @@ public:
 	}
 };
 
+/// Per-instance data, read from binding 1 once per instance rather than
+/// once per vertex, so N copies of a mesh can be drawn with one call.
+class imInstance {
+public:
+	/// Model transform of this copy, applied before the ubo's model matrix.
+	glm::mat4 transform;
+	/// Free per-instance parameters, currently an RGBA tint.
+	glm::vec4 params;
+
+	static VkVertexInputBindingDescription GetBindingDescription() {
+		VkVertexInputBindingDescription bindingDesc = { };
+		bindingDesc.binding = 1;
+		bindingDesc.stride = sizeof(imInstance);
+		bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+		return bindingDesc;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 5> GetAttrDescription() {
+		std::array<VkVertexInputAttributeDescription, 5> attrDesc = { };
+
+		// A mat4 attribute takes one location per column, following
+		// the per-vertex attributes at locations 0 through 2.
+		for (uint32_t i = 0; i < 4; i++) {
+			attrDesc[i].binding = 1;
+			attrDesc[i].location = 3 + i;
+			attrDesc[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+			attrDesc[i].offset = offsetof(imInstance, transform) + sizeof(glm::vec4) * i;
+		}
+
+		attrDesc[4].binding = 1;
+		attrDesc[4].location = 7;
+		attrDesc[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attrDesc[4].offset = offsetof(imInstance, params);
+
+		return attrDesc;
+	}
+};
+
 /// Temporary constant array of vertices for testing.
 const std::vector<imVertex> VERTICES = {
 	{ { -0.5f, -0.5f,  0.25f },	{ 1.0f, 0.2f, 0.0f },	{ 1.0f, 0.0f } },
@@ -12,6 +12,9 @@ VkDevice device = VK_NULL_HANDLE;
 VkCommandPool commandPool = VK_NULL_HANDLE;
 VkQueue graphicsQueue = VK_NULL_HANDLE;
 VkQueue presentQueue = VK_NULL_HANDLE;
+VkQueue transferQueue = VK_NULL_HANDLE;
+uint32_t instanceVersion = VK_API_VERSION_1_0;
+bool descriptorIndexingSupported = false;
 
 QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice &pDevice, VkSurfaceKHR &surface) {
 	QueueFamilyIndices indicies;
@@ -38,9 +41,23 @@ QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice &pDevice, VkSurfaceKHR &su
 			indicies.graphicsFamily = i;
 		}
 
+		// Families without graphics or compute are backed by dedicated
+		// DMA engines, which can copy while the graphics queue keeps rendering.
+		if (queueFamily.queueCount > 0 && 
+				(queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+				!(queueFamily.queueFlags & 
+					(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+			indicies.transferFamily = i;
+		}
+
 		i++;
 	}
 
+	// Graphics queues always support transfers, fall back to that.
+	if (indicies.transferFamily < 0) {
+		indicies.transferFamily = indicies.graphicsFamily;
+	}
+
 	return indicies;
 }
 
@@ -95,7 +112,7 @@ VkFormat FindSupportedFormat(const std::vector<VkFormat> &candidates,
 		}
 	}
 	
-	throw std::runtime_error("Failed to find a supported depth buffer format!");
+	throw std::runtime_error("Failed to find a supported format!");
 }
 
 VkFormat FindDepthFormat() {
@@ -104,36 +121,3 @@ VkFormat FindDepthFormat() {
 		VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
 	);
 }
-
-VkCommandBuffer BeginSingleTimeCommands() {
-	VkCommandBufferAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = commandPool;
-	allocInfo.commandBufferCount = 1;
-
-	VkCommandBuffer commandBuffer;
-	vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-	VkCommandBufferBeginInfo beginInfo = {};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-	vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-	return commandBuffer;
-}
-
-void EndSingleTimeCommands(VkCommandBuffer commandBuffer) {
-	vkEndCommandBuffer(commandBuffer);
-
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-
-	vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(graphicsQueue);
-
-	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-}
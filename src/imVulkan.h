@@ -27,6 +27,15 @@ extern VkCommandPool commandPool;
 extern VkQueue graphicsQueue;
 /// Handle to the presentation queue for presenting to the GLFW window.
 extern VkQueue presentQueue;
+/// Handle to the queue uploads are submitted to. This is a dedicated transfer
+/// queue when the device has one, otherwise it is the graphics queue.
+extern VkQueue transferQueue;
+/// Vulkan version the instance was created for, 1.1 where the loader
+/// supports it and 1.0 otherwise.
+extern uint32_t instanceVersion;
+/// True if the device was created with VK_EXT_descriptor_indexing and the
+/// features bindless textures need, see imBindlessTextures.
+extern bool descriptorIndexingSupported;
 
 
 /// Stores supported swap chain details for a given physical device.
@@ -40,6 +49,8 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
 	int graphicsFamily = -1;
 	int presentFamily = -1;
+	/// Transfer only family if one exists, falls back to the graphics family.
+	int transferFamily = -1;
 
 	bool IsComplete() {
 		return (graphicsFamily >= 0) && (presentFamily >= 0);
@@ -57,7 +68,8 @@ SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice &pDevice);
 bool HasStencilComponent(VkFormat format);
 /// Choose the best format available to use for the depth buffer.
 VkFormat FindDepthFormat();
-/// Find available formats to use when creating the depth buffer.
+/// First of the 'candidates' supporting 'features' with the given tiling,
+/// throws if there is none.
 VkFormat FindSupportedFormat(const std::vector<VkFormat> &candidates,
 	VkImageTiling tiling, VkFormatFeatureFlags features);
 
@@ -68,9 +80,4 @@ struct UniformBufferObject {
 	glm::mat4 proj;
 };
 
-/// Create a command bufer which we only wish to submit once.
-VkCommandBuffer BeginSingleTimeCommands();
-/// Submit, wait, then free the input command buffer.
-void EndSingleTimeCommands(VkCommandBuffer commandBuffer);
-
 #endif
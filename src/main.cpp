@@ -8,10 +8,35 @@
  */
 
 int main(int argc, char ** argv) {
+	bool pipelineBench = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--pipeline-bench") == 0) {
+			pipelineBench = true;
+		} else if (strcmp(argv[i], "--texture-budget") == 0) {
+			// In MiB, the tails of every texture are kept regardless.
+			const char * value = i + 1 < argc ? argv[++i] : "";
+			char * end = nullptr;
+			errno = 0;
+			unsigned long mib = strtoul(value, &end, 10);
+			if (*value < '0' || *value > '9' || *end != '\0' || mib == 0 ||
+					errno == ERANGE) {
+				std::cerr << "Usage: " << argv[0]
+					<< " [--pipeline-bench] [--texture-budget <MiB>]" << std::endl;
+				return EXIT_FAILURE;
+			}
+
+			textureStreamer.budget = static_cast<VkDeviceSize>(mib) * 1024 * 1024;
+		}
+	}
+
 	imApplication app(SCREENW, SCREENH, APP_NAME);
 
 	try {
-		app.Run();
+		if (pipelineBench) {
+			app.BenchmarkPipelines();
+		} else {
+			app.Run();
+		}
 	} catch ( const std::runtime_error &e ) {
 		std::cerr << e.what() << std::endl;
 		return EXIT_FAILURE;
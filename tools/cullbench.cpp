@@ -0,0 +1,84 @@
+#include "../src/imFrustum.h"
+
+#include <algorithm>
+#include <random>
+
+/*
+ * Compares the scalar and SIMD frustum culling kernels.
+ * Usage: cullbench [iterations]
+ */
+
+/// Object counts to benchmark.
+static const uint32_t COUNTS[] = { 10000, 100000, 1000000 };
+
+/// Average milliseconds per call of culling 'set' with the given path.
+static double TimeCull(const imSphereSet &set, const imFrustum &frustum,
+		imCullPath path, int iterations, std::vector<uint32_t> &visible) {
+	// Warm the caches and size the output list.
+	set.Cull(frustum, visible, path);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; i++) {
+		set.Cull(frustum, visible, path);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+int main(int argc, char ** argv) {
+	int iterations = argc > 1 ? std::max(1, atoi(argv[1])) : 20;
+
+	// Same camera setup as the demo, looking into a volume of scattered spheres.
+	glm::mat4 view = glm::lookAt(glm::vec3(60.0f, 60.0f, 60.0f),
+		glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+	imFrustum frustum = imFrustum::FromMatrix(proj * view);
+
+	std::vector<imCullPath> paths = { IM_CULL_SCALAR };
+	for (int path = IM_CULL_SSE; path <= imSphereSet::BestPath(); path++) {
+		paths.push_back(static_cast<imCullPath>(path));
+	}
+
+	std::cout << "-----------------------------------------------" << std::endl;
+	std::cout << "Frustum culling, " << iterations << " iterations per test" << std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> size(0.1f, 2.0f);
+
+	for (uint32_t count : COUNTS) {
+		imSphereSet set;
+		for (uint32_t i = 0; i < count; i++) {
+			set.Add(glm::vec3(position(rng), position(rng), position(rng)), size(rng));
+		}
+
+		// The scalar path runs first and is what the others are checked against.
+		std::vector<uint32_t> reference;
+		double scalarTime = 0.0;
+
+		for (imCullPath path : paths) {
+			std::vector<uint32_t> visible;
+			double time = TimeCull(set, frustum, path, iterations, visible);
+
+			if (path == IM_CULL_SCALAR) {
+				reference = visible;
+				scalarTime = time;
+				std::cout << count << " objects, " << reference.size() 
+					<< " visible" << std::endl;
+			} else if (visible != reference) {
+				std::cerr << "Visible lists differ from the scalar path!" << std::endl;
+				return EXIT_FAILURE;
+			}
+
+			std::cout << "\t- " << imSphereSet::PathName(path) << ": " << time << " ms ("
+				<< time * 1e6 / count << " ns/object, " << scalarTime / time << "x)"
+				<< std::endl;
+		}
+
+		std::cout << "-----------------------------------------------" << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
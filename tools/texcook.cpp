@@ -0,0 +1,304 @@
+#include "../src/imTextureFile.h"
+#include "../src/imBlockEncoder.h"
+#include "../src/imMipChain.h"
+#include "../src/imThreadPool.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+#include <sstream>
+#include <map>
+
+/*
+ * Cooks source images into KTX2 textures the demo uploads without decoding.
+ * Usage: texcook [--bc7 | --bc1 | --rgba8] [--linear] [--force]
+ *                [--threads n] [--manifest file] image...
+ * Every image.png is written beside it as image.ktx2, with a full mip chain.
+ * Images are sRGB unless --linear is given, for data such as normal maps.
+ * The manifest records a hash of each source and its settings, images whose
+ * hash hasn't changed since their last cook are skipped.
+ */
+
+/// Bump whenever the output for the same input changes, to recook everything.
+static const uint32_t COOK_VERSION = 1;
+/// Rows of blocks encoded per job, small enough to balance across cores.
+static const uint32_t ROWS_PER_JOB = 16;
+
+/// Output encodings, as named on the command line.
+enum imCookFormat {
+	IM_COOK_BC7,
+	IM_COOK_BC1,
+	IM_COOK_RGBA8
+};
+
+static const char * FormatName(imCookFormat format) {
+	switch (format) {
+		case IM_COOK_BC7: return "BC7";
+		case IM_COOK_BC1: return "BC1";
+		default: return "RGBA8";
+	}
+}
+
+static VkFormat VulkanFormat(imCookFormat format, bool srgb) {
+	switch (format) {
+		case IM_COOK_BC7:
+			return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+		case IM_COOK_BC1:
+			return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		default:
+			return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	}
+}
+
+/// One image on its way from source to KTX2.
+struct imCookJob {
+	std::string source;
+	std::string output;
+	uint64_t hash = 0;
+	size_t sourceBytes = 0;
+
+	imMipChain chain;
+	imTextureFile texture;
+	bool opaque = true;
+	/// Set by a worker that failed, the job is then dropped.
+	std::string error;
+};
+
+static bool ReadFile(const std::string &filename, std::vector<uint8_t> &contents) {
+	std::ifstream stream(filename, std::ios::ate | std::ios::binary);
+	if (!stream.is_open()) {
+		return false;
+	}
+
+	contents.resize((size_t)stream.tellg());
+	stream.seekg(0);
+	return static_cast<bool>(stream.read(reinterpret_cast<char *>(contents.data()),
+		contents.size()));
+}
+
+/// FNV-1a over 'size' bytes, continuing from 'hash'.
+static uint64_t Hash(const void * data, size_t size,
+		uint64_t hash = 14695981039346656037ull) {
+	const uint8_t * bytes = static_cast<const uint8_t *>(data);
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+/// Previously cooked outputs and the hash they were cooked from.
+static std::map<std::string, uint64_t> ReadManifest(const std::string &filename) {
+	std::map<std::string, uint64_t> manifest;
+	std::ifstream stream(filename);
+
+	std::string line;
+	while (std::getline(stream, line)) {
+		std::istringstream fields(line);
+		std::string output;
+		uint64_t hash;
+		if (fields >> std::hex >> hash && std::getline(fields >> std::ws, output)) {
+			manifest[output] = hash;
+		}
+	}
+
+	return manifest;
+}
+
+static void WriteManifest(const std::string &filename,
+		const std::map<std::string, uint64_t> &manifest) {
+	std::ofstream stream(filename, std::ios::trunc);
+	for (const auto &entry : manifest) {
+		stream << std::hex << entry.second << " " << entry.first << std::endl;
+	}
+}
+
+/// Load the source and build its mip chain.
+static void Prepare(imCookJob &job, imCookFormat format, bool srgb) {
+	int width, height, channels;
+	stbi_uc * pixels = stbi_load(job.source.c_str(), &width, &height,
+		&channels, STBI_rgb_alpha);
+	if (!pixels) {
+		job.error = "failed to load image";
+		return;
+	}
+
+	uint32_t levels = imMipChain::LevelsFor(width, height);
+	job.chain.Generate(pixels, width, height, levels, srgb);
+	for (size_t i = 3; i < static_cast<size_t>(width) * height * 4; i += 4) {
+		job.opaque = job.opaque && pixels[i] == 255;
+	}
+
+	stbi_image_free(pixels);
+
+	// Every level is laid out back to back, the encoders fill them in place.
+	imTextureFile &texture = job.texture;
+	texture.format = VulkanFormat(format, srgb);
+	texture.width = static_cast<uint32_t>(width);
+	texture.height = static_cast<uint32_t>(height);
+	for (uint32_t level = 0; level < levels; level++) {
+		size_t size = static_cast<size_t>(imTextureFile::LevelSize(texture.format,
+			std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u)));
+		texture.levels.push_back({ texture.data.size(), size });
+		texture.data.resize(texture.data.size() + size);
+	}
+
+	if (format == IM_COOK_RGBA8) {
+		for (uint32_t level = 0; level < levels; level++) {
+			memcpy(texture.data.data() + texture.levels[level].offset,
+				job.chain.Level(level), job.chain.LevelSize(level));
+		}
+	}
+}
+
+int main(int argc, char ** argv) {
+	imCookFormat format = IM_COOK_BC7;
+	bool srgb = true;
+	bool force = false;
+	uint32_t threads = std::thread::hardware_concurrency();
+	std::string manifestFile = "texcook.manifest";
+	std::vector<std::string> sources;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--bc7") { format = IM_COOK_BC7; }
+		else if (arg == "--bc1") { format = IM_COOK_BC1; }
+		else if (arg == "--rgba8") { format = IM_COOK_RGBA8; }
+		else if (arg == "--linear") { srgb = false; }
+		else if (arg == "--force") { force = true; }
+		else if (arg == "--threads" && i + 1 < argc) { threads = atoi(argv[++i]); }
+		else if (arg == "--manifest" && i + 1 < argc) { manifestFile = argv[++i]; }
+		else if (arg.compare(0, 2, "--") == 0) {
+			std::cerr << "Unknown option " << arg << std::endl;
+			return EXIT_FAILURE;
+		} else {
+			sources.push_back(arg);
+		}
+	}
+
+	if (sources.empty()) {
+		std::cerr << "Usage: texcook [--bc7 | --bc1 | --rgba8] [--linear] [--force] "
+			<< "[--threads n] [--manifest file] image..." << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "-----------------------------------------------" << std::endl;
+	std::cout << "Cooking " << sources.size() << " image" << (sources.size() == 1 ? "" : "s")
+		<< " as " << FormatName(format) << (srgb ? " sRGB" : " linear") << std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::map<std::string, uint64_t> manifest = ReadManifest(manifestFile);
+	std::string settings = std::to_string(COOK_VERSION) + FormatName(format) +
+		(srgb ? "srgb" : "linear");
+
+	// Only sources whose contents or settings changed are cooked again.
+	std::vector<imCookJob> jobs;
+	uint32_t skipped = 0;
+	uint32_t failures = 0;
+	for (const std::string &source : sources) {
+		imCookJob job;
+		job.source = source;
+		job.output = source.substr(0, source.find_last_of('.')) + ".ktx2";
+
+		std::vector<uint8_t> contents;
+		if (!ReadFile(source, contents)) {
+			std::cerr << source << ": failed to read" << std::endl;
+			failures++;
+			continue;
+		}
+
+		job.sourceBytes = contents.size();
+		job.hash = Hash(settings.data(), settings.size(),
+			Hash(contents.data(), contents.size()));
+
+		auto cooked = manifest.find(job.output);
+		bool current = cooked != manifest.end() && cooked->second == job.hash &&
+			std::ifstream(job.output).good();
+		if (current && !force) {
+			std::cout << source << ": unchanged, skipped" << std::endl;
+			skipped++;
+			continue;
+		}
+
+		jobs.push_back(std::move(job));
+	}
+
+	threadPool.Create(std::max(threads, 1u));
+
+	// Decoding and downsampling are serial per image, so images run side by side.
+	for (imCookJob &job : jobs) {
+		threadPool.Submit([&job, format, srgb] { Prepare(job, format, srgb); });
+	}
+
+	threadPool.Wait();
+
+	// Block compression splits every level into bands of rows.
+	if (format != IM_COOK_RGBA8) {
+		imBlockFormat blockFormat = format == IM_COOK_BC1 ? IM_BLOCK_BC1 : IM_BLOCK_BC7;
+
+		for (imCookJob &job : jobs) {
+			if (!job.error.empty()) { continue; }
+
+			for (uint32_t level = 0; level < job.chain.LevelCount(); level++) {
+				uint32_t width = std::max(job.texture.width >> level, 1u);
+				uint32_t height = std::max(job.texture.height >> level, 1u);
+				uint32_t rows = imBlockEncoder::BlockRows(height);
+				const uint8_t * pixels = job.chain.Level(level);
+				uint8_t * out = job.texture.data.data() + job.texture.levels[level].offset;
+
+				for (uint32_t row = 0; row < rows; row += ROWS_PER_JOB) {
+					uint32_t last = std::min(row + ROWS_PER_JOB, rows);
+					threadPool.Submit([=] {
+						imBlockEncoder::EncodeRows(blockFormat, pixels, width, height,
+							row, last, out);
+					});
+				}
+			}
+		}
+
+		threadPool.Wait();
+	}
+
+	threadPool.Cleanup();
+
+	for (imCookJob &job : jobs) {
+		if (job.error.empty()) {
+			try {
+				job.texture.Save(job.output);
+			} catch (std::runtime_error &e) {
+				job.error = e.what();
+			}
+		}
+
+		if (!job.error.empty()) {
+			std::cerr << job.source << ": " << job.error << std::endl;
+			manifest.erase(job.output);
+			failures++;
+			continue;
+		}
+
+		manifest[job.output] = job.hash;
+		std::cout << job.source << " -> " << job.output << ", " << job.texture.width
+			<< "x" << job.texture.height << ", " << job.texture.levels.size()
+			<< " levels, " << job.sourceBytes / 1024 << " KiB -> "
+			<< job.texture.data.size() / 1024 << " KiB" << std::endl;
+
+		if (format == IM_COOK_BC1 && !job.opaque) {
+			std::cout << "\t- has transparent texels, which BC1 drops, use --bc7" << std::endl;
+		}
+	}
+
+	WriteManifest(manifestFile, manifest);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << "-----------------------------------------------" << std::endl;
+	std::cout << sources.size() - skipped - failures << " cooked, " << skipped
+		<< " skipped, " << failures << " failed in "
+		<< std::chrono::duration<double, std::milli>(end - start).count() << " ms on "
+		<< std::max(threads, 1u) << " thread" << (threads > 1 ? "s" : "") << std::endl;
+	std::cout << "-----------------------------------------------" << std::endl;
+
+	return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}